@@ -0,0 +1,188 @@
+
+#include "combine\combiner.h"
+
+#include <QtConcurrentMap>
+#include <QElapsedTimer>
+
+#include <emmintrin.h>
+
+struct QCombinerRow
+{
+	typedef void result_type;
+
+	QCombinerRow(QCombiner* Combiner) :
+		Combiner(Combiner)
+	{
+	}
+
+	void operator()(const int& Y) const
+	{
+		this->Combiner->CombineRow(Y);
+	}
+
+	QCombiner* Combiner;
+};
+
+QCombiner::QCombiner(QObject* Parent /*= 0*/) :
+	QObject(Parent),
+	Radiance(false),
+	Resolution(0, 0),
+	Inputs(),
+	Estimates(),
+	Exposure(0.1f),
+	Output(0),
+	Rows()
+{
+}
+
+float QCombiner::Combine(const Vec2i& Resolution, const QVector<const unsigned char*>& Inputs, unsigned char* Output)
+{
+	QElapsedTimer Timer;
+
+	Timer.start();
+
+	this->Radiance		= false;
+	this->Resolution	= Resolution;
+	this->Inputs		= Inputs;
+	this->Output		= Output;
+
+	if (this->Rows.size() != Resolution[1])
+	{
+		this->Rows.resize(Resolution[1]);
+
+		for (int Y = 0; Y < Resolution[1]; Y++)
+			this->Rows[Y] = Y;
+	}
+
+	if (this->Inputs.size() > 0)
+		QtConcurrent::blockingMap(this->Rows, QCombinerRow(this));
+
+	return (float)Timer.nsecsElapsed() / 1000000.0f;
+}
+
+float QCombiner::CombineRadiance(const Vec2i& Resolution, const QList<QEstimate*>& Inputs, const float& Exposure, unsigned char* Output)
+{
+	QElapsedTimer Timer;
+
+	Timer.start();
+
+	this->Radiance		= true;
+	this->Resolution	= Resolution;
+	this->Estimates		= Inputs;
+	this->Exposure		= Exposure;
+	this->Output		= Output;
+
+	if (this->Rows.size() != Resolution[1])
+	{
+		this->Rows.resize(Resolution[1]);
+
+		for (int Y = 0; Y < Resolution[1]; Y++)
+			this->Rows[Y] = Y;
+	}
+
+	if (this->Estimates.size() > 0)
+		QtConcurrent::blockingMap(this->Rows, QCombinerRow(this));
+
+	return (float)Timer.nsecsElapsed() / 1000000.0f;
+}
+
+void QCombiner::CombineRow(const int& Y)
+{
+	if (this->Radiance)
+		this->WeighRadianceRow(Y);
+	else
+		this->AverageRow(Y);
+}
+
+void QCombiner::AverageRow(const int& Y)
+{
+	const int NoBytes	= this->Resolution[0] * 3;
+	const int Offset	= Y * NoBytes;
+	const int NoInputs	= this->Inputs.size();
+
+	const float InvNoInputs = 1.0f / (float)NoInputs;
+
+	const __m128 Scale	= _mm_set1_ps(InvNoInputs);
+	const __m128i Zero	= _mm_setzero_si128();
+
+	int i = 0;
+
+	// Sixteen channels at a time, widened to 32 bit sums so the number of inputs is unbounded
+	for (; i + 16 <= NoBytes; i += 16)
+	{
+		__m128i Sum[4] = { Zero, Zero, Zero, Zero };
+
+		for (int e = 0; e < NoInputs; e++)
+		{
+			const __m128i Bytes = _mm_loadu_si128((const __m128i*)(this->Inputs[e] + Offset + i));
+
+			const __m128i Low	= _mm_unpacklo_epi8(Bytes, Zero);
+			const __m128i High	= _mm_unpackhi_epi8(Bytes, Zero);
+
+			Sum[0] = _mm_add_epi32(Sum[0], _mm_unpacklo_epi16(Low, Zero));
+			Sum[1] = _mm_add_epi32(Sum[1], _mm_unpackhi_epi16(Low, Zero));
+			Sum[2] = _mm_add_epi32(Sum[2], _mm_unpacklo_epi16(High, Zero));
+			Sum[3] = _mm_add_epi32(Sum[3], _mm_unpackhi_epi16(High, Zero));
+		}
+
+		__m128i Mean[4];
+
+		for (int k = 0; k < 4; k++)
+			Mean[k] = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(Sum[k]), Scale));
+
+		const __m128i Words[2] = { _mm_packs_epi32(Mean[0], Mean[1]), _mm_packs_epi32(Mean[2], Mean[3]) };
+
+		_mm_storeu_si128((__m128i*)(this->Output + Offset + i), _mm_packus_epi16(Words[0], Words[1]));
+	}
+
+	for (; i < NoBytes; i++)
+	{
+		int Sum = 0;
+
+		for (int e = 0; e < NoInputs; e++)
+			Sum += this->Inputs[e][Offset + i];
+
+		this->Output[Offset + i] = (unsigned char)(InvNoInputs * (float)Sum);
+	}
+}
+
+void QCombiner::WeighRadianceRow(const int& Y)
+{
+	const int NoInputs = this->Estimates.size();
+
+	for (int X = 0; X < this->Resolution[0]; X++)
+	{
+		ColorXYZAf Sum(0.0f, 0.0f, 0.0f, 1.0f);
+
+		float SumWeights = 0.0f;
+
+		for (int e = 0; e < NoInputs; e++)
+		{
+			QEstimate* Input = this->Estimates[e];
+
+			const float Weight = (float)Input->GetSampleCounts()(X / Input->GetTileSize(), Y / Input->GetTileSize());
+
+			const ColorXYZf& Radiance = Input->GetRadiance()(X, Y);
+
+			for (int c = 0; c < 3; c++)
+				Sum[c] += Weight * Radiance[c];
+
+			SumWeights += Weight;
+		}
+
+		if (SumWeights > 0.0f)
+		{
+			for (int c = 0; c < 3; c++)
+				Sum[c] /= SumWeights;
+		}
+
+		Sum.ToneMap(this->Exposure);
+
+		const ColorRGBAuc RGBA = ColorRGBAuc::FromXYZAf(Sum.D);
+
+		unsigned char* Pixel = this->Output + (Y * this->Resolution[0] + X) * 3;
+
+		for (int c = 0; c < 3; c++)
+			Pixel[c] = RGBA[c];
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "utilities\general\estimate.h"
+
+#include <QObject>
+#include <QVector>
+#include <QList>
+
+/*! Combines the estimates of replicated renderers on the host
+	The rows are combined in parallel on the global thread pool, straight into a preallocated output, without a round trip to the device
+*/
+class QCombiner : public QObject
+{
+    Q_OBJECT
+
+public:
+	QCombiner(QObject* Parent = 0);
+	virtual ~QCombiner() {};
+
+	float Combine(const Vec2i& Resolution, const QVector<const unsigned char*>& Inputs, unsigned char* Output);
+	float CombineRadiance(const Vec2i& Resolution, const QList<QEstimate*>& Inputs, const float& Exposure, unsigned char* Output);
+	void CombineRow(const int& Y);
+
+private:
+	void AverageRow(const int& Y);
+	void WeighRadianceRow(const int& Y);
+
+private:
+	bool							Radiance;
+	Vec2i							Resolution;
+	QVector<const unsigned char*>	Inputs;
+	QList<QEstimate*>				Estimates;
+	float							Exposure;
+	unsigned char*					Output;
+	QVector<int>					Rows;
+};
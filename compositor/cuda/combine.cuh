@@ -1,11 +0,0 @@
-#pragma once
-
-#include "buffer\buffers.h"
-#include "color\color.h"
-
-namespace ExposureRender
-{
-
-extern "C" float Combine(int Width, int Height, unsigned char* Estimates[20], const int& NoEstimates, unsigned char* Estimate);
-
-}
\ No newline at end of file
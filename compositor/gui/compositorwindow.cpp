@@ -3,6 +3,8 @@
 #include "utilities\gui\renderoutputwidget.h"
 #include "server\rendererserver.h"
 #include "server\guiserver.h"
+#include "server\session.h"
+#include "socket\renderersocket.h"
 
 #include <QtGui>
 
@@ -32,7 +34,7 @@ QCompositorWindow::QCompositorWindow(QRendererServer* RendererServer, QGuiServer
 	this->Connections->setRootIsDecorated(false);
 	this->Connections->setColumnCount(7);
 	this->Connections->setColumnWidth(0, 70);
-	this->Connections->setColumnWidth(1, 85);
+	this->Connections->setColumnWidth(1, 130);
 	this->Connections->setColumnWidth(2, 85);
 	this->Connections->setColumnWidth(3, 85);
 	this->Connections->setColumnWidth(4, 85);
@@ -60,6 +62,51 @@ QCompositorWindow::~QCompositorWindow()
 void QCompositorWindow::OnTimer()
 {
 //	this->RenderOutputWidget->SetImage(this->RendererServer->Estimate);
+
+	this->UpdateConnections();
+}
+
+void QCompositorWindow::UpdateConnections()
+{
+	QList<QRendererSocket*> Renderers = this->RendererServer->GetConnectedRenderers();
+
+	while (this->Connections->topLevelItemCount() > Renderers.size())
+		delete this->Connections->takeTopLevelItem(this->Connections->topLevelItemCount() - 1);
+
+	while (this->Connections->topLevelItemCount() < Renderers.size())
+		this->Connections->addTopLevelItem(new QTreeWidgetItem());
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		QRendererSocket* Renderer = Renderers[r];
+		QTreeWidgetItem* Item = this->Connections->topLevelItem(r);
+
+		const HostBuffer2D<ColorRGBuc>& Buffer = Renderer->Estimate->GetBuffer();
+
+		QSession* Session = Renderer->GetSession();
+
+		QString Status = "Unassigned";
+
+		if (Session)
+		{
+			if (Session->Paused)
+				Status = "Paused";
+			else if ((Session->Tiled && Renderer->NoTileRows == 0) || (Session->Bricked && !Renderer->HasBrick()))
+				Status = "Idle";
+			else
+				Status = "Rendering";
+
+			Status += QString(" (session %1)").arg(Session->GetID());
+		}
+
+		Item->setText(0, Renderer->peerAddress().toString());
+		Item->setText(1, Status);
+		Item->setText(2, QString("%1 x %2").arg(Buffer.Width()).arg(Buffer.Height()));
+		Item->setText(3, QString("%1 MS/s, %2 ms, queue %3 (%4 dropped)").arg(Renderer->GetCapacity() / 1000000.0f, 0, 'f', 2).arg(Renderer->RenderTime, 0, 'f', 1).arg(Renderer->QueueDepth).arg(Renderer->NoDroppedImages));
+		Item->setText(4, QString("%1 ms").arg(Renderer->EncodeTime, 0, 'f', 1));
+		Item->setText(5, QString("%1 ms").arg(Renderer->DecodeTime.GetAverageValue(), 0, 'f', 1));
+		Item->setText(6, Renderer->Device);
+	}
 }
 
 void QCompositorWindow::CreateStatusBar()
@@ -20,6 +20,7 @@ public:
 	virtual ~QCompositorWindow();
 
 	void CreateStatusBar();
+	void UpdateConnections();
 	QRenderOutputWidget* GetRenderOutputWidget() { return this->RenderOutputWidget; }
 
 public slots:
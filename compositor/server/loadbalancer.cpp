@@ -0,0 +1,128 @@
+
+#include "loadbalancer.h"
+
+#include <math.h>
+
+QVector<int> QLoadBalancer::Apportion(const QVector<float>& Capacities, const int& NoUnits, const int& MinUnits /*= 0*/)
+{
+	const int NoNodes = Capacities.size();
+
+	QVector<int> Units(NoNodes, 0);
+
+	if (NoNodes <= 0 || NoUnits <= 0)
+		return Units;
+
+	// Nodes without a capacity measurement yet are assumed to be as fast as the average of the others
+	QVector<float> Weights(NoNodes, 0.0f);
+
+	float SumMeasured = 0.0f;
+	int NoMeasured = 0;
+
+	for (int n = 0; n < NoNodes; n++)
+	{
+		Weights[n] = Capacities[n];
+
+		if (Weights[n] > 0.0f)
+		{
+			SumMeasured += Weights[n];
+			NoMeasured++;
+		}
+	}
+
+	for (int n = 0; n < NoNodes; n++)
+	{
+		if (Weights[n] <= 0.0f)
+			Weights[n] = NoMeasured > 0 ? SumMeasured / (float)NoMeasured : 1.0f;
+	}
+
+	// The fastest nodes take part, ties in the order they were given
+	QList<QPair<float, int> > Order;
+
+	for (int n = 0; n < NoNodes; n++)
+		Order.append(qMakePair(-Weights[n], n));
+
+	qStableSort(Order);
+
+	const int MinNodeUnits = qMax(MinUnits, 0);
+
+	int NoActive = qMin(NoNodes, MinNodeUnits > 0 ? NoUnits / MinNodeUnits : NoUnits);
+
+	float SumWeights = 0.0f;
+
+	for (int a = 0; a < NoActive; a++)
+		SumWeights += Weights[Order[a].second];
+
+	// A node that would take longer for a single unit than the others take for the entire balanced frame only delays the frame, it stays idle
+	while (MinNodeUnits == 0 && NoActive > 1 && 1.0f / Weights[Order[NoActive - 1].second] > (float)NoUnits / (SumWeights - Weights[Order[NoActive - 1].second]))
+	{
+		SumWeights -= Weights[Order[NoActive - 1].second];
+		NoActive--;
+	}
+
+	// Largest remainder over the units left after the guaranteed minimum of every active node
+	QVector<float> Remainders(NoActive, 0.0f);
+
+	const int NoSpareUnits = NoUnits - NoActive * MinNodeUnits;
+
+	int NoAssigned = NoActive * MinNodeUnits;
+
+	for (int a = 0; a < NoActive; a++)
+	{
+		const float Quota = (float)NoSpareUnits * Weights[Order[a].second] / SumWeights;
+
+		Units[Order[a].second]	= MinNodeUnits + (int)floorf(Quota);
+		Remainders[a]			= Quota - floorf(Quota);
+		NoAssigned				+= (int)floorf(Quota);
+	}
+
+	while (NoAssigned < NoUnits)
+	{
+		int Largest = 0;
+
+		for (int a = 1; a < NoActive; a++)
+		{
+			if (Remainders[a] > Remainders[Largest])
+				Largest = a;
+		}
+
+		Units[Order[Largest].second]++;
+		Remainders[Largest] = -1.0f;
+		NoAssigned++;
+	}
+
+	return Units;
+}
+
+bool QLoadBalancer::NeedsRebalance(const QVector<int>& Current, const QVector<int>& Target, const int& Threshold)
+{
+	if (Current.size() != Target.size())
+		return true;
+
+	int NoCurrent = 0, NoTarget = 0;
+
+	for (int n = 0; n < Target.size(); n++)
+	{
+		NoCurrent	+= Current[n];
+		NoTarget	+= Target[n];
+
+		if (qAbs(Current[n] - Target[n]) > Threshold || (Current[n] > 0) != (Target[n] > 0))
+			return true;
+	}
+
+	// An assignment that does not cover all units leaves holes in the frame
+	return NoCurrent != NoTarget;
+}
+
+float QLoadBalancer::GetFrameTime(const QVector<float>& Capacities, const QVector<int>& Units, const float& UnitCost)
+{
+	// A frame is complete once the slowest node has delivered its share
+	float FrameTime = 0.0f;
+
+	for (int n = 0; n < qMin(Capacities.size(), Units.size()); n++)
+	{
+		if (Units[n] > 0 && Capacities[n] > 0.0f)
+			FrameTime = qMax(FrameTime, (float)Units[n] * UnitCost / Capacities[n]);
+	}
+
+	return FrameTime;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QVector>
+#include <QList>
+#include <QPair>
+#include <QtAlgorithms>
+
+/*! Apportions work units over renderers in proportion to their capacity, renderers too slow to contribute to a frame without delaying it stay idle
+	The policy only sees capacities and unit counts, so it can be driven by simulated nodes as well as by connected renderers
+*/
+class QLoadBalancer
+{
+public:
+	static QVector<int> Apportion(const QVector<float>& Capacities, const int& NoUnits, const int& MinUnits = 0);
+	static bool NeedsRebalance(const QVector<int>& Current, const QVector<int>& Target, const int& Threshold);
+	static float GetFrameTime(const QVector<float>& Capacities, const QVector<int>& Units, const float& UnitCost);
+};
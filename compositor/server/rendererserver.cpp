@@ -1,64 +1,182 @@
 
 #include "server\rendererserver.h"
 #include "server\guiserver.h"
+#include "server\session.h"
+#include "server\loadbalancer.h"
 #include "socket\renderersocket.h"
-#include "cuda\combine.cuh"
+
+#include <QApplication>
+#include <QVector>
+#include <QPair>
+#include <QtAlgorithms>
 
 QRendererServer::QRendererServer(QObject* Parent /*= 0*/) :
 	QBaseServer("Renderer", Parent),
 	Settings("compositor.ini", QSettings::IniFormat),
 	GuiServer(0),
-	Timer(),
-	Estimate()
+	ScheduleTimer(),
+	Sessions(),
+	NoSessions(0),
+	ResourceCache(QApplication::applicationDirPath() + "//resources")
 {
 	this->ListenPort = Settings.value("network/rendererport", 6000).toInt();
 
-	connect(&this->Timer, SIGNAL(timeout()), this, SLOT(OnCombineEstimates()));
+	connect(&this->ScheduleTimer, SIGNAL(timeout()), this, SLOT(OnSchedule()));
 }
 
 void QRendererServer::OnNewConnection(const int& SocketDescriptor)
 {
-	QRendererSocket* RendererSocket = new QRendererSocket(SocketDescriptor, this->GuiServer, this);
+	QRendererSocket* RendererSocket = new QRendererSocket(SocketDescriptor, this);
 	this->Connections.append(RendererSocket);
+
+	connect(RendererSocket, SIGNAL(disconnected()), this, SLOT(OnRendererDisconnected()));
+
+	QByteArray Data;
+
+	// Renderers only render on behalf of a session
+	if (this->Sessions.isEmpty())
+		RendererSocket->SendData(Protocol::Pause, Data);
+
+	this->OnSchedule();
 }
 
 void QRendererServer::OnStarted()
 {
-	const int CombineFps = this->Settings.value("general/combinefps", 30).toFloat();
+	this->ScheduleTimer.start(this->Settings.value("sessions/scheduleinterval", 1000).toInt());
+}
+
+QList<QRendererSocket*> QRendererServer::GetConnectedRenderers()
+{
+	QList<QRendererSocket*> Renderers;
+
+	for (int c = 0; c < this->Connections.size(); c++)
+	{
+		if (this->Connections[c]->state() == QAbstractSocket::ConnectedState)
+			Renderers.append((QRendererSocket*)this->Connections[c]);
+	}
+
+	return Renderers;
+}
+
+QSession* QRendererServer::CreateSession(QGuiSocket* GuiSocket)
+{
+	QSession* Session = new QSession(++this->NoSessions, GuiSocket, &this->ResourceCache, this);
+
+	this->Sessions.append(Session);
+
+	qDebug() << "Session" << Session->GetID() << "started," << this->Sessions.size() << "sessions";
 
-	this->Timer.start(1000.0f / CombineFps);
+	this->OnSchedule();
+
+	return Session;
 }
 
-void QRendererServer::OnCombineEstimates()
+void QRendererServer::RemoveSession(QSession* Session)
 {
-	if (this->Connections.size() == 0)
+	if (!this->Sessions.removeOne(Session))
 		return;
 
-	unsigned char* Estimates[20];
-	int NoEstimates = 0;
+	qDebug() << "Session" << Session->GetID() << "ended," << this->Sessions.size() << "sessions";
 
-	for (int c = 0; c < this->Connections.size(); c++)
+	QList<QRendererSocket*> Renderers = Session->GetRenderers();
+
+	for (int r = 0; r < Renderers.size(); r++)
+		Session->RemoveRenderer(Renderers[r]);
+
+	Session->deleteLater();
+
+	this->OnSchedule();
+}
+
+void QRendererServer::OnRendererDisconnected()
+{
+	QRendererSocket* RendererSocket = (QRendererSocket*)this->sender();
+
+	if (RendererSocket->GetSession())
+		RendererSocket->GetSession()->RemoveRenderer(RendererSocket);
+
+	this->OnSchedule();
+}
+
+void QRendererServer::OnSchedule()
+{
+	QList<QRendererSocket*> Renderers = this->GetConnectedRenderers();
+
+	QByteArray Data;
+
+	// Without sessions there is nothing to render
+	if (this->Sessions.isEmpty())
 	{
-		if (this->Connections[c]->state() == QAbstractSocket::ConnectedState)
+		for (int r = 0; r < Renderers.size(); r++)
 		{
-			QRendererSocket* RendererSocket = (QRendererSocket*)this->Connections[c];
+			if (!Renderers[r]->GetSession())
+				continue;
 
-			if (!RendererSocket->Estimate.GetBuffer().IsEmpty())
-			{
-				Estimates[NoEstimates] = (unsigned char*)(RendererSocket->Estimate.GetBuffer().GetData());
-				NoEstimates++;
-			}
+			Renderers[r]->GetSession()->RemoveRenderer(Renderers[r]);
+			Renderers[r]->SendData(Protocol::Pause, Data);
 		}
+
+		return;
 	}
-	
-	this->Estimate.GetBuffer().Resize(Vec2i(640, 480));
 
-	if (NoEstimates > 0)
-		ExposureRender::Combine(this->Estimate.GetBuffer().Width(), this->Estimate.GetBuffer().Height(), Estimates, NoEstimates, (unsigned char*)this->Estimate.GetBuffer().GetData());
-	
-	QByteArray Data;
+	// Sessions are ranked by priority, equal priorities take turns by credit, so a pool smaller than the number of sessions is time sliced
+	QList<QPair<QPair<float, float>, QSession*> > Ranking;
 
-	if (this->Estimate.ToByteArray(Data))
-		this->GuiServer->SendDataToAll("ESTIMATE", Data);
-}
+	for (int s = 0; s < this->Sessions.size(); s++)
+		Ranking.append(qMakePair(qMakePair(-this->Sessions[s]->GetPriority(), -this->Sessions[s]->GetCredit()), this->Sessions[s]));
+
+	qSort(Ranking);
+
+	QVector<float> Weights(Ranking.size(), 0.0f);
+
+	for (int s = 0; s < Ranking.size(); s++)
+		Weights[s] = -Ranking[s].first.first;
+
+	// Sessions are apportioned renderers by weight, every session gets one while there are enough, and as many as possible stay with their current session since moving one means uploading the volume again
+	const QVector<int> NoRenderers = QLoadBalancer::Apportion(Weights, Renderers.size(), 1);
+
+	QVector<int> NoKept(Ranking.size(), 0);
+	QList<QPair<float, QRendererSocket*> > Free;
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		int Rank = -1;
+
+		for (int s = 0; s < Ranking.size(); s++)
+		{
+			if (Ranking[s].second == Renderers[r]->GetSession())
+				Rank = s;
+		}
 
+		if (Rank >= 0 && NoKept[Rank] < NoRenderers[Rank])
+		{
+			NoKept[Rank]++;
+			continue;
+		}
+
+		if (Renderers[r]->GetSession())
+			Renderers[r]->GetSession()->RemoveRenderer(Renderers[r]);
+
+		Free.append(qMakePair(-Renderers[r]->GetCapacity(), Renderers[r]));
+	}
+
+	// The fastest free renderers go to the sessions with the highest priority
+	qSort(Free);
+
+	for (int s = 0; s < Ranking.size(); s++)
+	{
+		while (NoKept[s] < NoRenderers[s] && !Free.isEmpty())
+		{
+			QRendererSocket* RendererSocket = Free.takeFirst().second;
+
+			qDebug() << "Assigning renderer" << RendererSocket->peerAddress().toString() << "to session" << Ranking[s].second->GetID();
+
+			Ranking[s].second->AddRenderer(RendererSocket);
+
+			NoKept[s]++;
+		}
+	}
+
+	for (int r = 0; r < Free.size(); r++)
+		Free[r].second->SendData(Protocol::Pause, Data);
+}
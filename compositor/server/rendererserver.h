@@ -1,12 +1,15 @@
 #pragma once
 
 #include "utilities\network\baseserver.h"
-#include "utilities\general\estimate.h"
+#include "utilities\network\resourcecache.h"
 
 #include <QSettings>
 #include <QTimer>
 
 class QGuiServer;
+class QGuiSocket;
+class QRendererSocket;
+class QSession;
 
 class QRendererServer : public QBaseServer
 {
@@ -16,17 +19,26 @@ public:
 	
 	QGuiServer*					GuiServer;
 
+	QSession* CreateSession(QGuiSocket* GuiSocket);
+	void RemoveSession(QSession* Session);
+
 protected:
 	void OnNewConnection(const int& SocketDescriptor);
 	void OnStarted();
 
 public slots:
-	void OnCombineEstimates();
+	void OnSchedule();
+	void OnRendererDisconnected();
+
+private:
+	QList<QRendererSocket*> GetConnectedRenderers();
 
 private:
-	QSettings		Settings;
-	QTimer			Timer;
-	QEstimate		Estimate;
+	QSettings			Settings;
+	QTimer				ScheduleTimer;
+	QList<QSession*>	Sessions;
+	int					NoSessions;
+	QResourceCache		ResourceCache;
 
 	friend class QCompositorWindow;
-};
\ No newline at end of file
+};
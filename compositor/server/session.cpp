@@ -0,0 +1,1064 @@
+
+#include "server\session.h"
+#include "server\loadbalancer.h"
+#include "socket\guisocket.h"
+#include "socket\renderersocket.h"
+
+#include <QDataStream>
+#include <QVector>
+#include <QPair>
+#include <QtAlgorithms>
+#include <QtConcurrentRun>
+
+QSession::QSession(const int& ID, QGuiSocket* GuiSocket, QResourceCache* ResourceCache, QObject* Parent /*= 0*/) :
+	QObject(Parent),
+	Settings("compositor.ini", QSettings::IniFormat),
+	ID(ID),
+	GuiSocket(GuiSocket),
+	ResourceCache(ResourceCache),
+	Renderers(),
+	VolumeReceiver(GuiSocket, ResourceCache),
+	VolumeInfo(),
+	Bitmaps(),
+	CameraData(),
+	LastInteraction(),
+	LastServed(),
+	Timer(),
+	RebalanceTimer(),
+	Outputs(),
+	CurrentOutput(0),
+	PendingOutput(-1),
+	EncodingOutput(-1),
+	Combining(false),
+	CombineWatcher(),
+	EncodeWatcher(),
+	CombineRenderers(),
+	NewestEpoch(0),
+	CombineEpoch(0),
+	NoSkippedCombines(0),
+	NoNewEstimates(0),
+	CombineNewEstimates(false),
+	Change(0.0f),
+	Paused(false),
+	NoConvergedFrames(0),
+	PriorityTimer(),
+	AdaptiveTileSize(32),
+	TileChanges(),
+	ErrorMap(),
+	Tiled(true),
+	Bricked(false),
+	FrameResolution(640, 480),
+	TileSize(32),
+	VolumeResolution(0, 0, 0),
+	VolumeSpacing(1.0f),
+	Voxels(),
+	CameraPosition(0.0f),
+	Exposure(0.1f),
+	Combiner(),
+	SendBuffers(),
+	CombineTime(),
+	NoCombines(0),
+	NoCombineInputs(0),
+	CombinedTime(0.0f),
+	NoCombinedInputs(0)
+{
+	this->Tiled				= Settings.value("rendering/distribution", "tiles").toString() == "tiles";
+	this->Bricked			= Settings.value("rendering/distribution", "tiles").toString() == "bricks";
+	this->FrameResolution	= Vec2i(Settings.value("rendering/imagewidth", 640).toInt(), Settings.value("rendering/imageheight", 480).toInt());
+	this->TileSize			= qMax(Settings.value("rendering/tilesize", 32).toInt(), 1);
+	this->Exposure			= Settings.value("rendering/exposure", 0.1).toFloat();
+	this->AdaptiveTileSize	= qMax(Settings.value("adaptive/tilesize", 32).toInt(), 1);
+
+	connect(&this->Timer, SIGNAL(timeout()), this, SLOT(OnCombineEstimates()));
+	connect(&this->RebalanceTimer, SIGNAL(timeout()), this, SLOT(OnAssignTiles()));
+	connect(&this->CombineWatcher, SIGNAL(finished()), this, SLOT(OnCombined()));
+	connect(&this->EncodeWatcher, SIGNAL(finished()), this, SLOT(OnEncoded()));
+	connect(&this->PriorityTimer, SIGNAL(timeout()), this, SLOT(OnSendPriorities()));
+
+	this->Timer.start(1000.0f / this->Settings.value("general/combinefps", 30).toFloat());
+
+	if (this->Tiled)
+		this->RebalanceTimer.start(this->Settings.value("rendering/rebalanceinterval", 2000).toInt());
+
+	if (this->Settings.value("adaptive/enabled", true).toBool())
+		this->PriorityTimer.start(this->Settings.value("adaptive/interval", 1000).toInt());
+
+	this->LastServed.start();
+}
+
+QSession::~QSession()
+{
+	// The pipeline stages run on the global thread pool and refer to this session
+	this->CombineWatcher.waitForFinished();
+	this->EncodeWatcher.waitForFinished();
+
+	for (int r = 0; r < this->CombineRenderers.size(); r++)
+		this->CombineRenderers[r]->Combining = false;
+}
+
+bool QSession::IsInteracting()
+{
+	return this->LastInteraction.isValid() && this->LastInteraction.elapsed() < this->Settings.value("sessions/interactiontimeout", 2000).toInt();
+}
+
+float QSession::GetPriority()
+{
+	// Sessions that are being interacted with need the lowest latency, converged sessions need hardly any renderers
+	if (this->IsInteracting())
+		return this->Settings.value("sessions/interactiveweight", 4.0).toFloat();
+
+	if (this->Paused)
+		return this->Settings.value("sessions/convergedweight", 0.25).toFloat();
+
+	return 1.0f;
+}
+
+float QSession::GetCredit()
+{
+	const int TimeSlice = this->Settings.value("sessions/timeslice", 5000).toInt();
+
+	// Served sessions hold on to their renderers for a time slice, waiting sessions gain credit for as long as they wait
+	if (this->Renderers.isEmpty())
+		return (float)this->LastServed.elapsed();
+
+	return (float)(TimeSlice - this->LastServed.elapsed());
+}
+
+void QSession::OnReceiveGuiData(const Protocol::Opcode& Opcode, QByteArray& Data)
+{
+	// A volume streams in chunks while the renderers keep rendering the previous one
+	if (Opcode == Protocol::Volume)
+	{
+		// A volume the cluster has seen before is taken from the cache, the gui then has nothing to upload
+		if (this->VolumeReceiver.OnHeader(Data))
+			this->OnVolumeReceived();
+
+		return;
+	}
+
+	if (Opcode == Protocol::VolumeChunk)
+	{
+		if (this->VolumeReceiver.OnChunk(Data))
+			this->OnVolumeReceived();
+
+		return;
+	}
+
+	// Every gui action changes the image, paused renderers resume as soon as they receive it
+	this->Resume();
+
+	this->LastInteraction.start();
+
+	if (Opcode == Protocol::Resolution)
+		this->SetResolution(Data);
+
+	if (Opcode == Protocol::Bitmap)
+	{
+		QDataStream DataStream(&Data, QIODevice::ReadOnly);
+		DataStream.setVersion(QDataStream::Qt_4_0);
+
+		QString FileName;
+		QByteArray Bitmap;
+
+		DataStream >> FileName;
+		DataStream >> Bitmap;
+
+		this->ResourceCache->Store(QResourceCache::GetHash(Bitmap), Bitmap);
+
+		this->Bitmaps[FileName] = QByteArray(Data.constData(), Data.size());
+		this->SendDataToAll(Opcode, this->Bitmaps[FileName]);
+	}
+
+	if (Opcode == Protocol::Camera)
+	{
+		this->CameraData = QByteArray(Data.constData(), Data.size());
+
+		this->SetCamera(Data);
+		this->SendDataToAll(Opcode, this->CameraData);
+	}
+}
+
+void QSession::AddRenderer(QRendererSocket* RendererSocket)
+{
+	if (this->Renderers.contains(RendererSocket))
+		return;
+
+	if (this->Renderers.isEmpty())
+		this->LastServed.start();
+
+	this->Renderers.append(RendererSocket);
+
+	RendererSocket->SetSession(this);
+
+	connect(RendererSocket, SIGNAL(EstimateDecoded()), this, SLOT(OnEstimateDecoded()));
+
+	// The renderer tags its estimates with the session, so estimates rendered for its previous session are never combined here
+	QByteArray Data;
+
+	QDataStream DataStream(&Data, QIODevice::WriteOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	DataStream << this->ID;
+
+	RendererSocket->SendData(Protocol::Session, Data);
+
+	// Replicated renderers are combined before tone mapping, weighted by their number of samples, and bricks are composited before tone mapping
+	if (!this->Tiled)
+	{
+		QByteArray Radiance;
+
+		RendererSocket->SendData(Protocol::Radiance, Radiance);
+	}
+
+	if (!this->Tiled && !this->Bricked)
+		this->SendCrop(RendererSocket, QRect(0, 0, this->FrameResolution[0], this->FrameResolution[1]));
+
+	// Bricks are sent when they are assigned
+	if (!this->Bricked && !this->Voxels.isEmpty())
+		RendererSocket->VolumeSender.Start(this->VolumeInfo, this->Voxels);
+
+	for (QMap<QString, QByteArray>::iterator Bitmap = this->Bitmaps.begin(); Bitmap != this->Bitmaps.end(); ++Bitmap)
+		RendererSocket->SendData(Protocol::Bitmap, Bitmap.value());
+
+	if (!this->CameraData.isEmpty())
+		RendererSocket->SendData(Protocol::Camera, this->CameraData);
+
+	this->OnAssignTiles();
+	this->OnAssignBricks();
+
+	this->Resume();
+}
+
+void QSession::RemoveRenderer(QRendererSocket* RendererSocket)
+{
+	if (!this->Renderers.removeOne(RendererSocket))
+		return;
+
+	disconnect(RendererSocket, SIGNAL(EstimateDecoded()), this, SLOT(OnEstimateDecoded()));
+
+	RendererSocket->SetSession(0);
+	RendererSocket->SetTileRows(0, 0);
+	RendererSocket->SetBrick(0, 0, 0);
+
+	if (this->Renderers.isEmpty())
+		this->LastServed.start();
+
+	// The remaining renderers take over the share of the one that left
+	this->OnAssignTiles();
+	this->OnAssignBricks();
+}
+
+void QSession::SendDataToAll(const Protocol::Opcode& Opcode, const QByteArray& Data)
+{
+	QList<QRendererSocket*> Renderers = this->GetConnectedRenderers();
+
+	for (int r = 0; r < Renderers.size(); r++)
+		Renderers[r]->SendData(Opcode, Data);
+}
+
+void QSession::SetResolution(QByteArray& Data)
+{
+	QDataStream DataStream(&Data, QIODevice::ReadOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	Vec2i Resolution;
+
+	DataStream >> Resolution[0];
+	DataStream >> Resolution[1];
+
+	if (Resolution[0] <= 0 || Resolution[1] <= 0 || Resolution == this->FrameResolution)
+		return;
+
+	qDebug() << "Session" << this->ID << "resolution" << Resolution[0] << "x" << Resolution[1];
+
+	this->FrameResolution = Resolution;
+
+	QList<QRendererSocket*> Renderers = this->GetConnectedRenderers();
+
+	// Every renderer renders a crop of the new frame, or all of it
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		if (this->Tiled)
+			Renderers[r]->SetTileRows(0, 0);
+		else
+			this->SendCrop(Renderers[r], QRect(0, 0, this->FrameResolution[0], this->FrameResolution[1]));
+	}
+
+	this->OnAssignTiles();
+}
+
+QList<QRendererSocket*> QSession::GetConnectedRenderers()
+{
+	QList<QRendererSocket*> Renderers;
+
+	for (int r = 0; r < this->Renderers.size(); r++)
+	{
+		if (this->Renderers[r]->state() == QAbstractSocket::ConnectedState)
+			Renderers.append(this->Renderers[r]);
+	}
+
+	return Renderers;
+}
+
+QRect QSession::GetCrop(const int& FirstTileRow, const int& NoTileRows)
+{
+	const int Y			= FirstTileRow * this->TileSize;
+	const int Height	= qMin(NoTileRows * this->TileSize, this->FrameResolution[1] - Y);
+
+	return QRect(0, Y, this->FrameResolution[0], qMax(Height, 0));
+}
+
+void QSession::SendCrop(QRendererSocket* RendererSocket, const QRect& Crop)
+{
+	QByteArray Data;
+
+	QDataStream DataStream(&Data, QIODevice::WriteOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	DataStream << this->FrameResolution[0];
+	DataStream << this->FrameResolution[1];
+
+	DataStream << Crop.x();
+	DataStream << Crop.y();
+
+	DataStream << Crop.width();
+	DataStream << Crop.height();
+
+	RendererSocket->SendData(Protocol::Crop, Data);
+
+	this->Resume();
+}
+
+void QSession::OnAssignTiles()
+{
+	if (!this->Tiled)
+		return;
+
+	QList<QRendererSocket*> Renderers = this->GetConnectedRenderers();
+
+	if (Renderers.size() == 0)
+		return;
+
+	const int NoTileRows = (int)ceilf((float)this->FrameResolution[1] / (float)this->TileSize);
+
+	QVector<float> Capacities(Renderers.size(), 0.0f);
+	QVector<int> Current(Renderers.size(), 0);
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		Capacities[r]	= Renderers[r]->GetCapacity();
+		Current[r]		= Renderers[r]->NoTileRows;
+	}
+
+	const QVector<int> Rows = QLoadBalancer::Apportion(Capacities, NoTileRows);
+
+	// Every move restarts the renderers involved, so only rebalance if the frame is not covered or the shares changed noticeably
+	if (!QLoadBalancer::NeedsRebalance(Current, Rows, this->Settings.value("rendering/rebalancethreshold", 1).toInt()))
+		return;
+
+	const float RowCost = (float)(this->FrameResolution[0] * this->TileSize);
+
+	qDebug() << "Rebalancing tile rows, expected frame time" << QLoadBalancer::GetFrameTime(Capacities, Current, RowCost) << "->" << QLoadBalancer::GetFrameTime(Capacities, Rows, RowCost) << "s";
+
+	int FirstTileRow = 0;
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		const int NoRows = Rows[r];
+
+		if (Renderers[r]->FirstTileRow == FirstTileRow && Renderers[r]->NoTileRows == NoRows)
+		{
+			FirstTileRow += NoRows;
+			continue;
+		}
+
+		Renderers[r]->SetTileRows(FirstTileRow, NoRows);
+
+		if (NoRows > 0)
+			this->SendCrop(Renderers[r], this->GetCrop(FirstTileRow, NoRows));
+
+		FirstTileRow += NoRows;
+	}
+}
+
+void QSession::OnVolumeReceived()
+{
+	// The voxel buffer the chunks were written into is kept for renderers joining later and shared by the senders, it is never copied
+	this->VolumeInfo		= this->VolumeReceiver.GetInfo();
+	this->Voxels			= this->VolumeReceiver.GetVoxels();
+	this->VolumeResolution	= this->VolumeInfo.Resolution;
+	this->VolumeSpacing		= this->VolumeInfo.Spacing;
+
+	this->VolumeReceiver.Release();
+
+	qDebug() << "Session" << this->ID << "received volume" << this->VolumeInfo.FileName;
+
+	this->Resume();
+
+	this->LastInteraction.start();
+
+	// With sort-last distribution every renderer only receives its own brick of the volume, otherwise every renderer streams the whole volume
+	if (!this->Bricked)
+	{
+		this->SendVolume(this->GetConnectedRenderers());
+		return;
+	}
+
+	// Force a redistribution, the bricks of the previous volume are stale
+	QList<QRendererSocket*> Renderers = this->GetConnectedRenderers();
+
+	for (int r = 0; r < Renderers.size(); r++)
+		Renderers[r]->SetBrick(0, 0, 0);
+
+	this->OnAssignBricks();
+}
+
+void QSession::SendVolume(QList<QRendererSocket*> Renderers)
+{
+	QList<QRendererSocket*> Chain;
+
+	// Renderers that accept relay connections pass the volume on to each other, so the uplink of the compositor carries it only once
+	if (this->Settings.value("volume/relay", false).toBool())
+	{
+		for (int r = 0; r < Renderers.size(); r++)
+		{
+			if (Renderers[r]->RelayPort > 0)
+				Chain.append(Renderers[r]);
+		}
+	}
+
+	if (Chain.size() < 2)
+		Chain.clear();
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		if (!Chain.contains(Renderers[r]))
+			Renderers[r]->VolumeSender.Start(this->VolumeInfo, this->Voxels);
+	}
+
+	if (Chain.isEmpty())
+		return;
+
+	// Every renderer is told its successor before the volume arrives, control messages overtake the bulk channel
+	for (int r = 0; r < Chain.size(); r++)
+	{
+		QByteArray Data;
+
+		QDataStream DataStream(&Data, QIODevice::WriteOnly);
+		DataStream.setVersion(QDataStream::Qt_4_0);
+
+		const bool Last = r == Chain.size() - 1;
+
+		DataStream << (Last ? QString() : Chain[r + 1]->peerAddress().toString());
+		DataStream << (Last ? (quint16)0 : Chain[r + 1]->RelayPort);
+		DataStream << this->VolumeInfo.ID;
+
+		Chain[r]->SendData(Protocol::Relay, Data);
+
+		if (r > 0)
+			Chain[r]->VolumeSender.Stop();
+	}
+
+	qDebug() << "Session" << this->ID << "relays volume" << this->VolumeInfo.FileName << "through" << Chain.size() << "renderers";
+
+	Chain[0]->VolumeSender.Start(this->VolumeInfo, this->Voxels);
+}
+
+void QSession::SetCamera(QByteArray& Data)
+{
+	QDataStream DataStream(&Data, QIODevice::ReadOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	for (int i = 0; i < 3; i++)
+		DataStream >> this->CameraPosition[i];
+}
+
+void QSession::OnAssignBricks()
+{
+	if (!this->Bricked || this->Voxels.isEmpty())
+		return;
+
+	QList<QRendererSocket*> Renderers = this->GetConnectedRenderers();
+
+	if (Renderers.size() == 0)
+		return;
+
+	// Slabs along the longest axis keep the visibility order trivial and the ghost layers small relative to the brick
+	int Axis = 0;
+
+	for (int i = 1; i < 3; i++)
+	{
+		if (this->VolumeResolution[i] * this->VolumeSpacing[i] > this->VolumeResolution[Axis] * this->VolumeSpacing[Axis])
+			Axis = i;
+	}
+
+	QVector<float> Capacities(Renderers.size(), 0.0f);
+
+	for (int r = 0; r < Renderers.size(); r++)
+		Capacities[r] = Renderers[r]->GetCapacity();
+
+	// Faster renderers get thicker slabs
+	const QVector<int> Slices = QLoadBalancer::Apportion(Capacities, this->VolumeResolution[Axis]);
+
+	int FirstSlice = 0;
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		const int Min = Slices[r] > 0 ? FirstSlice : 0;
+		const int Max = Slices[r] > 0 ? FirstSlice + Slices[r] : 0;
+
+		FirstSlice += Slices[r];
+
+		if (Renderers[r]->BrickAxis == Axis && Renderers[r]->BrickMin == Min && Renderers[r]->BrickMax == Max)
+			continue;
+
+		Renderers[r]->SetBrick(Axis, Min, Max);
+
+		if (Renderers[r]->HasBrick())
+			this->SendBrick(Renderers[r]);
+	}
+}
+
+void QSession::SendBrick(QRendererSocket* RendererSocket)
+{
+	const int Axis			= RendererSocket->BrickAxis;
+	const int GhostLayers	= qMax(this->Settings.value("rendering/ghostlayers", 2).toInt(), 0);
+
+	Vec3i CoreMin(0, 0, 0), CoreMax = this->VolumeResolution;
+
+	CoreMin[Axis] = RendererSocket->BrickMin;
+	CoreMax[Axis] = RendererSocket->BrickMax;
+
+	// The ghost layers give the brick the neighbouring voxels it needs for sampling and gradients at its boundary
+	Vec3i Offset = CoreMin, End = CoreMax;
+
+	Offset[Axis]	= qMax(CoreMin[Axis] - GhostLayers, 0);
+	End[Axis]		= qMin(CoreMax[Axis] + GhostLayers, this->VolumeResolution[Axis]);
+
+	const Vec3i Resolution(End[0] - Offset[0], End[1] - Offset[1], End[2] - Offset[2]);
+
+	QByteArray BrickVoxels(Resolution.CumulativeProduct() * sizeof(short), 0);
+
+	const short* Source	= (const short*)this->Voxels.constData();
+	short* Target		= (short*)BrickVoxels.data();
+
+	for (int Z = 0; Z < Resolution[2]; Z++)
+	{
+		for (int Y = 0; Y < Resolution[1]; Y++)
+		{
+			const int SourceID = ((Offset[2] + Z) * this->VolumeResolution[1] + Offset[1] + Y) * this->VolumeResolution[0] + Offset[0];
+			const int TargetID = (Z * Resolution[1] + Y) * Resolution[0];
+
+			memcpy(&Target[TargetID], &Source[SourceID], Resolution[0] * sizeof(short));
+		}
+	}
+
+	QByteArray Data;
+
+	QDataStream DataStream(&Data, QIODevice::WriteOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	for (int i = 0; i < 3; i++)
+		DataStream << this->VolumeResolution[i];
+
+	for (int i = 0; i < 3; i++)
+		DataStream << this->VolumeSpacing[i];
+
+	for (int i = 0; i < 3; i++)
+		DataStream << Offset[i];
+
+	for (int i = 0; i < 3; i++)
+		DataStream << Resolution[i];
+
+	for (int i = 0; i < 3; i++)
+		DataStream << CoreMin[i];
+
+	for (int i = 0; i < 3; i++)
+		DataStream << CoreMax[i];
+
+	DataStream << BrickVoxels;
+
+	RendererSocket->SendData(Protocol::Brick, Data);
+
+	this->Resume();
+
+	// Every brick renders the entire frame
+	this->SendCrop(RendererSocket, QRect(0, 0, this->FrameResolution[0], this->FrameResolution[1]));
+}
+
+void QSession::StitchEstimates(QEstimate& Estimate)
+{
+	// Crops are stitched into a frame of their own, the outputs alternate, so rows without a crop keep what was last published rather than flashing black
+	this->StitchedFrame.Resize(this->FrameResolution);
+
+	HostBuffer2D<ColorRGBuc>& Output = this->StitchedFrame;
+
+	const QList<QRendererSocket*>& Renderers = this->CombineRenderers;
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		const QRect Crop = this->GetCrop(Renderers[r]->FirstTileRow, Renderers[r]->NoTileRows);
+
+		if (Renderers[r]->NoTileRows <= 0 || !Renderers[r]->HasAssignedCrop(Crop) || !this->IsCombinedEpoch(Renderers[r]))
+			continue;
+
+		HostBuffer2D<ColorRGBuc>& Input = Renderers[r]->Estimate->GetBuffer();
+
+		for (int Y = 0; Y < Crop.height(); Y++)
+			memcpy(&Output(Crop.x(), Crop.y() + Y), &Input(0, Y), Crop.width() * sizeof(ColorRGBuc));
+	}
+
+	Estimate.GetBuffer() = this->StitchedFrame;
+}
+
+void QSession::CompositeBricks(QEstimate& Estimate)
+{
+	const QList<QRendererSocket*>& Renderers = this->CombineRenderers;
+
+	// Slabs along one axis are visibility ordered by their distance to the camera along that axis, a ray never crosses slabs on both sides of the camera
+	QList<QPair<float, QRendererSocket*> > Order;
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		QRendererSocket* RendererSocket = Renderers[r];
+
+		QEstimate& Input = *RendererSocket->Estimate;
+
+		if (!RendererSocket->HasBrick() || !this->IsCombinedEpoch(RendererSocket) || Input.GetOpacity().IsEmpty() || Input.GetRadiance().GetResolution() != this->FrameResolution || Input.GetOpacity().GetResolution() != this->FrameResolution)
+			continue;
+
+		const int Axis = RendererSocket->BrickAxis;
+
+		const float Min	= RendererSocket->BrickMin * this->VolumeSpacing[Axis];
+		const float Max	= RendererSocket->BrickMax * this->VolumeSpacing[Axis];
+		const float C	= this->CameraPosition[Axis];
+
+		Order.append(qMakePair(qMax(qMax(Min - C, C - Max), 0.0f), RendererSocket));
+	}
+
+	qSort(Order);
+
+	Estimate.GetBuffer().Resize(this->FrameResolution);
+
+	HostBuffer2D<ColorRGBuc>& Output = Estimate.GetBuffer();
+
+	const int NoPixels = Output.GetNoElements();
+
+	// Front-to-back over operator on the premultiplied radiance, tone mapping is not linear, so it is applied once to the composited pixel
+	for (int i = 0; i < NoPixels; i++)
+	{
+		ColorXYZAf Color(0.0f, 0.0f, 0.0f, 1.0f);
+
+		float Alpha = 0.0f;
+
+		for (int o = 0; o < Order.size() && Alpha < 1.0f; o++)
+		{
+			QEstimate& Input = *Order[o].second->Estimate;
+
+			const float Transmittance = 1.0f - Alpha;
+
+			for (int c = 0; c < 3; c++)
+				Color[c] += Transmittance * Input.GetRadiance()[i][c];
+
+			Alpha += Transmittance * (float)Input.GetOpacity()[i] / 255.0f;
+		}
+
+		Color.ToneMap(this->Exposure);
+
+		const ColorRGBAuc RGBA = ColorRGBAuc::FromXYZAf(Color.D);
+
+		for (int c = 0; c < 3; c++)
+			Output[i][c] = RGBA[c];
+	}
+}
+
+bool QSession::CombineRadiance(QEstimate& Estimate)
+{
+	QList<QEstimate*> Inputs;
+
+	const QList<QRendererSocket*>& Renderers = this->CombineRenderers;
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		QEstimate& Input = *Renderers[r]->Estimate;
+
+		if (Input.GetRadiance().Width() == this->FrameResolution[0] && Input.GetRadiance().Height() == this->FrameResolution[1] && Input.GetTileSize() > 0 && this->IsCombinedEpoch(Renderers[r]))
+			Inputs.append(&Input);
+	}
+
+	if (Inputs.size() == 0)
+		return false;
+
+	Estimate.GetBuffer().Resize(this->FrameResolution);
+
+	this->CombinedTime		= this->Combiner.CombineRadiance(this->FrameResolution, Inputs, this->Exposure, (unsigned char*)Estimate.GetBuffer().GetData());
+	this->NoCombinedInputs	= Inputs.size();
+
+	return true;
+}
+
+void QSession::ReportCombineTime()
+{
+	// The combine stage only leaves its time behind, the counters and the gui socket belong to this thread
+	if (this->NoCombinedInputs == 0)
+		return;
+
+	this->CombineTime.PushValue(this->CombinedTime);
+
+	if (this->NoCombinedInputs != this->NoCombineInputs)
+	{
+		this->NoCombineInputs	= this->NoCombinedInputs;
+		this->NoCombines		= 0;
+	}
+
+	// Log the combine cost per node count and resolution every few seconds of compositing
+	if (this->NoCombines++ % 100 != 0)
+		return;
+
+	int NoSupersededEstimates = 0, NoStaleEstimates = 0;
+
+	for (int r = 0; r < this->CombineRenderers.size(); r++)
+	{
+		NoSupersededEstimates	+= this->CombineRenderers[r]->NoSupersededEstimates;
+		NoStaleEstimates		+= this->CombineRenderers[r]->NoStaleEstimates;
+	}
+
+	qDebug() << QString("Combined %1 renderers at %2 x %3 in %4 ms, %5 combines skipped, %6 estimates superseded before decoding, %7 of an older view dropped, %8 messages (%9 KB) queued for the gui").arg(this->NoCombineInputs).arg(this->FrameResolution[0]).arg(this->FrameResolution[1]).arg(this->CombineTime.GetAverageValue(), 0, 'f', 2).arg(this->NoSkippedCombines).arg(NoSupersededEstimates).arg(NoStaleEstimates).arg(this->GuiSocket->GetQueueDepth()).arg(this->GuiSocket->GetNoQueuedBytes() / 1024);
+}
+
+void QSession::CombineReplicas(QEstimate& Estimate)
+{
+	QVector<const unsigned char*> Inputs;
+
+	const QList<QRendererSocket*>& Renderers = this->CombineRenderers;
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		HostBuffer2D<ColorRGBuc>& Input = Renderers[r]->Estimate->GetBuffer();
+
+		if (Input.Width() == this->FrameResolution[0] && Input.Height() == this->FrameResolution[1] && this->IsCombinedEpoch(Renderers[r]))
+			Inputs.append((const unsigned char*)Input.GetData());
+	}
+	
+	Estimate.GetBuffer().Resize(this->FrameResolution);
+
+	if (Inputs.size() == 0)
+		return;
+
+	this->CombinedTime		= this->Combiner.Combine(this->FrameResolution, Inputs, (unsigned char*)Estimate.GetBuffer().GetData());
+	this->NoCombinedInputs	= Inputs.size();
+}
+
+void QSession::OnCombineEstimates()
+{
+	if (this->Renderers.size() == 0 || this->Paused)
+		return;
+
+	// At most one frame is combined and one waits for the encoder, further ticks are skipped rather than queued
+	if (this->Combining || this->CurrentOutput == this->PendingOutput || this->CurrentOutput == this->EncodingOutput)
+	{
+		this->NoSkippedCombines++;
+		return;
+	}
+
+	// Nor is a frame composited while the gui has not taken the previous one, a congested link then stays a single frame behind
+	if (this->GuiSocket->IsQueued(Protocol::Estimate))
+	{
+		this->NoSkippedCombines++;
+		return;
+	}
+
+	this->PublishEstimates();
+
+	// The combine stage only sees this snapshot, connections made meanwhile join the next frame
+	this->CombineRenderers = this->GetConnectedRenderers();
+
+	// Renderers that have not caught up with the latest view are left out rather than averaged with the ones that have
+	this->CombineEpoch = 0;
+
+	for (int r = 0; r < this->CombineRenderers.size(); r++)
+	{
+		if (!this->CombineRenderers[r]->Estimate->GetBuffer().IsEmpty())
+			this->CombineEpoch = qMax(this->CombineEpoch, this->CombineRenderers[r]->Estimate->GetEpoch());
+	}
+
+	// A frame with crops or bricks of an older view would show missing slabs or mixed patches, the gui keeps the last complete frame instead
+	if (!this->IsFrameComplete())
+	{
+		this->NoSkippedCombines++;
+		return;
+	}
+
+	this->CombineNewEstimates	= this->NoNewEstimates > 0;
+	this->NoNewEstimates		= 0;
+
+	for (int r = 0; r < this->CombineRenderers.size(); r++)
+		this->CombineRenderers[r]->Combining = true;
+
+	this->Combining = true;
+
+	this->CombineWatcher.setFuture(QtConcurrent::run(this, &QSession::Combine, &this->Outputs[this->CurrentOutput]));
+}
+
+void QSession::OnEstimateDecoded()
+{
+	if (!this->Combining)
+		this->PublishEstimates();
+}
+
+void QSession::PublishEstimates()
+{
+	QList<QRendererSocket*> Renderers = this->GetConnectedRenderers();
+
+	for (int r = 0; r < Renderers.size(); r++)
+	{
+		if (Renderers[r]->PublishEstimate())
+			this->NoNewEstimates++;
+	}
+}
+
+void QSession::Combine(QEstimate* Estimate)
+{
+	this->NoCombinedInputs = 0;
+
+	Estimate->SetEpoch(this->CombineEpoch);
+
+	if (this->Bricked)
+		this->CompositeBricks(*Estimate);
+	else if (this->Tiled)
+		this->StitchEstimates(*Estimate);
+	else if (!this->CombineRadiance(*Estimate))
+		this->CombineReplicas(*Estimate);
+
+	if (this->CombineNewEstimates)
+		this->Change = this->GetChange(*Estimate, this->Outputs[Estimate == &this->Outputs[0] ? 1 : 0]);
+}
+
+bool QSession::IsCombinedEpoch(QRendererSocket* RendererSocket) const
+{
+	return RendererSocket->Estimate->GetEpoch() == this->CombineEpoch;
+}
+
+bool QSession::IsFrameComplete()
+{
+	// Replicas each render the entire frame, any one of them at the latest view makes a complete frame
+	if (!this->Tiled && !this->Bricked)
+		return true;
+
+	int NoParts = 0;
+
+	for (int r = 0; r < this->CombineRenderers.size(); r++)
+	{
+		QRendererSocket* RendererSocket = this->CombineRenderers[r];
+
+		if (this->Tiled && RendererSocket->NoTileRows > 0)
+		{
+			if (!RendererSocket->HasAssignedCrop(this->GetCrop(RendererSocket->FirstTileRow, RendererSocket->NoTileRows)) || !this->IsCombinedEpoch(RendererSocket))
+				return false;
+
+			NoParts++;
+		}
+
+		if (this->Bricked && RendererSocket->HasBrick())
+		{
+			QEstimate& Input = *RendererSocket->Estimate;
+
+			if (Input.GetOpacity().GetResolution() != this->FrameResolution || Input.GetRadiance().GetResolution() != this->FrameResolution || !this->IsCombinedEpoch(RendererSocket))
+				return false;
+
+			NoParts++;
+		}
+	}
+
+	return NoParts > 0;
+}
+
+float QSession::GetChange(QEstimate& Estimate, QEstimate& Previous)
+{
+	HostBuffer2D<ColorRGBuc>& Current	= Estimate.GetBuffer();
+	HostBuffer2D<ColorRGBuc>& Prior		= Previous.GetBuffer();
+
+	if (Current.GetNoElements() == 0 || Current.GetResolution() != Prior.GetResolution())
+		return 255.0f;
+
+	const int AdaptiveTileSize = this->AdaptiveTileSize;
+
+	// The change per tile feeds the error map that steers adaptive sampling
+	this->TileChanges.Resize(Vec2i((Current.Width() + AdaptiveTileSize - 1) / AdaptiveTileSize, (Current.Height() + AdaptiveTileSize - 1) / AdaptiveTileSize));
+	this->TileChanges.Reset();
+
+	long long Sum = 0;
+
+	for (int Y = 0; Y < Current.Height(); Y++)
+	{
+		const unsigned char* A = (const unsigned char*)&Current(0, Y);
+		const unsigned char* B = (const unsigned char*)&Prior(0, Y);
+
+		for (int X = 0; X < Current.Width(); X++)
+		{
+			const int Change = qAbs((int)A[X * 3] - (int)B[X * 3]) + qAbs((int)A[X * 3 + 1] - (int)B[X * 3 + 1]) + qAbs((int)A[X * 3 + 2] - (int)B[X * 3 + 2]);
+
+			this->TileChanges(X / AdaptiveTileSize, Y / AdaptiveTileSize) += (float)Change;
+
+			Sum += Change;
+		}
+	}
+
+	for (int i = 0; i < this->TileChanges.GetNoElements(); i++)
+		this->TileChanges[i] /= (float)(AdaptiveTileSize * AdaptiveTileSize * 3);
+
+	return (float)Sum / (float)(Current.GetNoElements() * 3);
+}
+
+void QSession::UpdateErrorMap()
+{
+	if (!this->CombineNewEstimates || this->TileChanges.IsEmpty())
+		return;
+
+	const float Smoothing = this->Settings.value("adaptive/smoothing", 0.8).toFloat();
+
+	if (this->ErrorMap.GetResolution() != this->TileChanges.GetResolution())
+	{
+		this->ErrorMap = this->TileChanges;
+		return;
+	}
+
+	for (int i = 0; i < this->ErrorMap.GetNoElements(); i++)
+		this->ErrorMap[i] = Smoothing * this->ErrorMap[i] + (1.0f - Smoothing) * this->TileChanges[i];
+}
+
+void QSession::OnSendPriorities()
+{
+	// Bricks are ray cast deterministically, there is no noise to steer
+	if (this->Paused || this->Bricked || this->ErrorMap.IsEmpty())
+		return;
+
+	const float MinPriority = this->Settings.value("adaptive/minpriority", 0.1).toFloat();
+
+	float MaxError = 0.0f;
+
+	for (int i = 0; i < this->ErrorMap.GetNoElements(); i++)
+		MaxError = qMax(MaxError, this->ErrorMap[i]);
+
+	if (MaxError <= 0.0f)
+		return;
+
+	// Every tile keeps a minimum share of the samples, so tiles that merely look converged still do converge
+	QByteArray Priorities(this->ErrorMap.GetNoElements(), 0);
+
+	for (int i = 0; i < this->ErrorMap.GetNoElements(); i++)
+		Priorities[i] = (char)(unsigned char)(255.0f * qBound(MinPriority, this->ErrorMap[i] / MaxError, 1.0f));
+
+	QByteArray Data;
+
+	QDataStream DataStream(&Data, QIODevice::WriteOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	DataStream << this->AdaptiveTileSize;
+	DataStream << this->ErrorMap.Width();
+	DataStream << this->ErrorMap.Height();
+	DataStream << Priorities;
+
+	QList<QRendererSocket*> Renderers = this->GetConnectedRenderers();
+
+	for (int r = 0; r < Renderers.size(); r++)
+		Renderers[r]->SendData(Protocol::Priority, Data);
+}
+
+void QSession::UpdateConvergence()
+{
+	const bool Enabled		= this->Settings.value("convergence/enabled", true).toBool();
+	const float Threshold	= this->Settings.value("convergence/threshold", 0.02).toFloat();
+	const int NoFrames		= this->Settings.value("convergence/noframes", 10).toInt();
+
+	// Combines without new estimates leave the image untouched, they say nothing about convergence
+	if (!Enabled || !this->CombineNewEstimates)
+		return;
+
+	if (this->Change > Threshold)
+	{
+		this->NoConvergedFrames = 0;
+		return;
+	}
+
+	if (++this->NoConvergedFrames < NoFrames)
+		return;
+
+	qDebug() << "Session" << this->ID << "converged, pausing renderers";
+
+	this->Paused = true;
+
+	QByteArray Data;
+
+	this->SendDataToAll(Protocol::Pause, Data);
+}
+
+void QSession::Resume()
+{
+	this->Paused			= false;
+	this->NoConvergedFrames	= 0;
+}
+
+void QSession::OnCombined()
+{
+	this->Combining = false;
+
+	for (int r = 0; r < this->CombineRenderers.size(); r++)
+		this->CombineRenderers[r]->Combining = false;
+
+	this->UpdateConvergence();
+	this->UpdateErrorMap();
+	this->ReportCombineTime();
+
+	this->PendingOutput	= this->CurrentOutput;
+	this->CurrentOutput	= 1 - this->CurrentOutput;
+
+	// Estimates decoded during the combine were held back, so the combine stage never reads a buffer that is being replaced
+	this->PublishEstimates();
+	this->StartEncode();
+}
+
+void QSession::StartEncode()
+{
+	if (this->EncodingOutput >= 0 || this->PendingOutput < 0)
+		return;
+
+	this->EncodingOutput	= this->PendingOutput;
+	this->PendingOutput		= -1;
+
+	// A gui on the same host takes the pixels through shared memory as they are, the socket is asked here since it belongs to this thread
+	const bool Raw = this->GuiSocket->IsSharedMemory();
+
+	this->EncodeWatcher.setFuture(QtConcurrent::run(this, &QSession::Encode, &this->Outputs[this->EncodingOutput], Raw));
+}
+
+QByteArray QSession::Encode(QEstimate* Estimate, const bool& Raw)
+{
+	QByteArray Data = this->SendBuffers.Acquire();
+
+	Estimate->SetRaw(Raw);
+
+	if (!Estimate->ToByteArray(Data))
+	{
+		this->SendBuffers.Release(Data);
+		return QByteArray();
+	}
+
+	return Data;
+}
+
+void QSession::OnEncoded()
+{
+	QByteArray Data = this->EncodeWatcher.result();
+
+	this->EncodingOutput = -1;
+
+	// Sockets are owned by this thread, so the send to the gui happens here
+	if (!Data.isEmpty() && this->GuiSocket->state() == QAbstractSocket::ConnectedState)
+		this->GuiSocket->SendData(Protocol::Estimate, Data);
+
+	// The buffer returns to the pool once the gui socket has sent it
+	this->SendBuffers.Release(Data);
+
+	this->StartEncode();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "utilities\general\estimate.h"
+#include "utilities\general\hysteresis.h"
+#include "utilities\network\sendbufferpool.h"
+#include "utilities\network\volumetransfer.h"
+#include "combine\combiner.h"
+
+#include <QObject>
+#include <QSettings>
+#include <QTimer>
+#include <QTime>
+#include <QRect>
+#include <QMap>
+#include <QFutureWatcher>
+
+class QGuiSocket;
+class QRendererSocket;
+
+/*! The state and compositing pipeline of a single gui
+	Every session has its own volume, camera, resolution and output, and composites the renderers the renderer server assigned to it
+*/
+class QSession : public QObject
+{
+	Q_OBJECT
+public:
+	QSession(const int& ID, QGuiSocket* GuiSocket, QResourceCache* ResourceCache, QObject* Parent = 0);
+	virtual ~QSession();
+
+	int GetID() const { return this->ID; }
+	QGuiSocket* GetGuiSocket() { return this->GuiSocket; }
+	bool IsBricked() const { return this->Bricked; }
+	bool IsPaused() const { return this->Paused; }
+	bool IsInteracting();
+	float GetPriority();
+	float GetCredit();
+	void OnReceiveGuiData(const Protocol::Opcode& Opcode, QByteArray& Data);
+	void AddRenderer(QRendererSocket* RendererSocket);
+	void RemoveRenderer(QRendererSocket* RendererSocket);
+	QList<QRendererSocket*> GetRenderers() const { return this->Renderers; }
+	QList<QRendererSocket*> GetConnectedRenderers();
+	void Resume();
+	bool IsStaleEpoch(const quint32& Epoch) const { return Epoch < this->NewestEpoch; }
+	void UpdateNewestEpoch(const quint32& Epoch) { this->NewestEpoch = qMax(this->NewestEpoch, Epoch); }
+
+public slots:
+	void OnCombineEstimates();
+	void OnEstimateDecoded();
+	void OnCombined();
+	void OnEncoded();
+	void OnAssignTiles();
+	void OnAssignBricks();
+	void OnSendPriorities();
+
+private:
+	void SendDataToAll(const Protocol::Opcode& Opcode, const QByteArray& Data);
+	void SetResolution(QByteArray& Data);
+	void OnVolumeReceived();
+	void SendVolume(QList<QRendererSocket*> Renderers);
+	void SetCamera(QByteArray& Data);
+	QRect GetCrop(const int& FirstTileRow, const int& NoTileRows);
+	void SendCrop(QRendererSocket* RendererSocket, const QRect& Crop);
+	void SendBrick(QRendererSocket* RendererSocket);
+	void PublishEstimates();
+	void Combine(QEstimate* Estimate);
+	bool IsCombinedEpoch(QRendererSocket* RendererSocket) const;
+	bool IsFrameComplete();
+	void StitchEstimates(QEstimate& Estimate);
+	void CompositeBricks(QEstimate& Estimate);
+	bool CombineRadiance(QEstimate& Estimate);
+	void CombineReplicas(QEstimate& Estimate);
+	void StartEncode();
+	QByteArray Encode(QEstimate* Estimate, const bool& Raw);
+	void ReportCombineTime();
+	float GetChange(QEstimate& Estimate, QEstimate& Previous);
+	void UpdateConvergence();
+	void UpdateErrorMap();
+
+private:
+	QSettings		Settings;
+	int				ID;
+	QGuiSocket*		GuiSocket;
+	QResourceCache*	ResourceCache;
+	QList<QRendererSocket*>	Renderers;
+	QVolumeReceiver	VolumeReceiver;
+	QVolumeInfo		VolumeInfo;
+	QMap<QString, QByteArray>	Bitmaps;
+	QByteArray		CameraData;
+	QTime			LastInteraction;
+	QTime			LastServed;
+	QTimer			Timer;
+	QTimer			RebalanceTimer;
+	QEstimate		Outputs[2];
+	HostBuffer2D<ColorRGBuc>	StitchedFrame;
+	int				CurrentOutput;
+	int				PendingOutput;
+	int				EncodingOutput;
+	bool			Combining;
+	QFutureWatcher<void>	CombineWatcher;
+	QFutureWatcher<QByteArray>	EncodeWatcher;
+	QList<QRendererSocket*>	CombineRenderers;
+	quint32			NewestEpoch;
+	quint32			CombineEpoch;
+	int				NoSkippedCombines;
+	int				NoNewEstimates;
+	bool			CombineNewEstimates;
+	float			Change;
+	bool			Paused;
+	int				NoConvergedFrames;
+	QTimer			PriorityTimer;
+	int				AdaptiveTileSize;
+	HostBuffer2D<float>	TileChanges;
+	HostBuffer2D<float>	ErrorMap;
+	bool			Tiled;
+	bool			Bricked;
+	Vec2i			FrameResolution;
+	int				TileSize;
+	Vec3i			VolumeResolution;
+	Vec3f			VolumeSpacing;
+	QByteArray		Voxels;
+	Vec3f			CameraPosition;
+	float			Exposure;
+	QCombiner		Combiner;
+	QSendBufferPool	SendBuffers;
+	QHysteresis		CombineTime;
+	int				NoCombines;
+	int				NoCombineInputs;
+	float			CombinedTime;
+	int				NoCombinedInputs;
+
+	friend class QCompositorWindow;
+};
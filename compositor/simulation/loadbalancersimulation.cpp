@@ -0,0 +1,133 @@
+#include "server\loadbalancer.h"
+
+#include <QtCore>
+
+#include <math.h>
+
+/*! Drives the load balancer with simulated renderers of known capacity, returns the number of failed checks */
+
+static int NoFailures = 0;
+
+static void Check(const bool& Passed, const QString& Description)
+{
+	qDebug() << (Passed ? "Passed:" : "FAILED:") << Description;
+
+	if (!Passed)
+		NoFailures++;
+}
+
+static QString ToString(const QVector<int>& Units)
+{
+	QStringList Strings;
+
+	for (int n = 0; n < Units.size(); n++)
+		Strings.append(QString::number(Units[n]));
+
+	return Strings.join(" ");
+}
+
+static int GetSum(const QVector<int>& Units)
+{
+	int Sum = 0;
+
+	for (int n = 0; n < Units.size(); n++)
+		Sum += Units[n];
+
+	return Sum;
+}
+
+static void CheckSplit(const QVector<float>& Capacities, const int& NoUnits)
+{
+	const QVector<int> Units = QLoadBalancer::Apportion(Capacities, NoUnits);
+
+	const QString Description = QString("%1 units over %2 nodes -> %3").arg(NoUnits).arg(Capacities.size()).arg(ToString(Units));
+
+	// Every unit is assigned and no node gets more than one unit away from its share of the capacity
+	float SumCapacities = 0.0f;
+
+	for (int n = 0; n < Capacities.size(); n++)
+		SumCapacities += Capacities[n];
+
+	bool Proportional = true;
+
+	for (int n = 0; n < Capacities.size(); n++)
+	{
+		const float Share = (float)NoUnits * Capacities[n] / SumCapacities;
+
+		if (fabsf((float)Units[n] - Share) > 1.0f)
+			Proportional = false;
+	}
+
+	Check(Units.size() == Capacities.size() && GetSum(Units) == NoUnits && Proportional, Description);
+}
+
+int main(int argc, char **argv)
+{
+	qDebug() << "Simulating load balancer";
+
+	// Equal and heterogeneous renderers
+	CheckSplit(QVector<float>() << 1.0f << 1.0f << 1.0f << 1.0f, 15);
+	CheckSplit(QVector<float>() << 1.0f << 2.0f << 3.0f << 4.0f, 100);
+	CheckSplit(QVector<float>() << 250.0f << 1000.0f, 23);
+
+	// A renderer without a measurement yet counts as an average one
+	const QVector<int> Unmeasured = QLoadBalancer::Apportion(QVector<float>() << 2.0f << 0.0f << 2.0f, 30);
+
+	Check(Unmeasured == (QVector<int>() << 10 << 10 << 10), "Unmeasured node -> " + ToString(Unmeasured));
+
+	// More renderers than units, the surplus renderers stay idle
+	const QVector<int> Surplus = QLoadBalancer::Apportion(QVector<float>() << 1.0f << 1.0f << 1.0f << 1.0f << 1.0f, 3);
+
+	Check(Surplus == (QVector<int>() << 1 << 1 << 1 << 0 << 0), "Surplus nodes -> " + ToString(Surplus));
+
+	// Few units are split by capacity too, not evenly
+	const QVector<int> Few = QLoadBalancer::Apportion(QVector<float>() << 1.0f << 3.0f, 4);
+
+	Check(Few == (QVector<int>() << 1 << 3), "Few units -> " + ToString(Few));
+
+	// The fastest renderers take part when there are more renderers than units
+	const QVector<int> Fastest = QLoadBalancer::Apportion(QVector<float>() << 1.0f << 3.0f << 2.0f, 2);
+
+	Check(Fastest == (QVector<int>() << 0 << 1 << 1), "Fastest nodes -> " + ToString(Fastest));
+
+	// A renderer that takes longer for a single unit than the others for the entire frame stays idle rather than delay every frame
+	const QVector<int> Slow = QLoadBalancer::Apportion(QVector<float>() << 0.001f << 100.0f, 10);
+
+	Check(Slow == (QVector<int>() << 0 << 10), "Very slow node -> " + ToString(Slow));
+
+	// Unless every node is guaranteed a unit, as sessions are
+	const QVector<int> Guaranteed = QLoadBalancer::Apportion(QVector<float>() << 0.001f << 100.0f, 10, 1);
+
+	Check(Guaranteed == (QVector<int>() << 1 << 9), "Guaranteed unit -> " + ToString(Guaranteed));
+
+	// Measurement noise within the threshold leaves the assignment alone, a real change in capacity does not
+	const QVector<float> Capacities = QVector<float>() << 1.0f << 1.0f << 2.0f;
+	const int NoTileRows = 34;
+
+	const QVector<int> Current = QLoadBalancer::Apportion(Capacities, NoTileRows);
+
+	const QVector<int> Jitter	= QLoadBalancer::Apportion(QVector<float>() << 1.05f << 0.97f << 2.02f, NoTileRows);
+	const QVector<int> Faster	= QLoadBalancer::Apportion(QVector<float>() << 2.0f << 1.0f << 2.0f, NoTileRows);
+
+	Check(!QLoadBalancer::NeedsRebalance(Current, Current, 1), "Unchanged capacities do not rebalance");
+	Check(!QLoadBalancer::NeedsRebalance(Current, Jitter, 1), "Jitter " + ToString(Current) + " -> " + ToString(Jitter) + " does not rebalance");
+	Check(QLoadBalancer::NeedsRebalance(Current, Faster, 1), "Faster node " + ToString(Current) + " -> " + ToString(Faster) + " rebalances");
+	Check(!QLoadBalancer::NeedsRebalance(Current, Faster, NoTileRows), "Faster node within a threshold of " + QString::number(NoTileRows) + " rows does not rebalance");
+
+	// Joining or leaving renderers and frames that are not covered always rebalance
+	Check(QLoadBalancer::NeedsRebalance(Current, QLoadBalancer::Apportion(QVector<float>(Capacities) << 1.0f, NoTileRows), 1), "Joining node rebalances");
+	Check(QLoadBalancer::NeedsRebalance(QVector<int>() << 0 << 17 << 17, QVector<int>() << 1 << 16 << 17, 1), "Idle node receiving units rebalances");
+	Check(QLoadBalancer::NeedsRebalance(QVector<int>() << 11 << 11 << 11, Current, 100), "Uncovered frame rebalances");
+
+	// Apportioning by capacity beats an equal split on heterogeneous renderers
+	const QVector<float> Heterogeneous = QVector<float>() << 1.0f << 4.0f;
+
+	const float EqualTime		= QLoadBalancer::GetFrameTime(Heterogeneous, QVector<int>() << 17 << 17, 1.0f);
+	const float BalancedTime	= QLoadBalancer::GetFrameTime(Heterogeneous, QLoadBalancer::Apportion(Heterogeneous, 34), 1.0f);
+
+	Check(BalancedTime < EqualTime, QString("Frame time %1 -> %2").arg(EqualTime).arg(BalancedTime));
+
+	qDebug() << NoFailures << "checks failed";
+
+	return NoFailures;
+}
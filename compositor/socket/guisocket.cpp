@@ -1,6 +1,7 @@
 
 #include "guisocket.h"
 #include "server\rendererserver.h"
+#include "server\session.h"
 
 #include <QFile>
 #include <QDebug>
@@ -8,30 +9,40 @@
 QGuiSocket::QGuiSocket(int SocketDescriptor, QRendererServer* RendererServer, QObject* Parent /*= 0*/) :
 	QBaseSocket(Parent),
 	Settings("compositor.ini", QSettings::IniFormat),
-	RendererServer(RendererServer)
+	RendererServer(RendererServer),
+	Session(0)
 {
+	this->SetSharedMemorySize(this->Settings.value("network/sharedmemory", 64).toInt() * 1024 * 1024);
+
 	if (!this->setSocketDescriptor(SocketDescriptor))
 		return;
 
 	qDebug() << SocketDescriptor << "gui connected";
+
+	connect(this, SIGNAL(disconnected()), this, SLOT(OnDisconnected()));
+
+	// Every gui gets its own volume, camera and output, rendered by a share of the renderer pool
+	this->Session = this->RendererServer->CreateSession(this);
 }
 
 QGuiSocket::~QGuiSocket()
 {
 }
 
-void QGuiSocket::OnReceiveData(const QString& Action, QByteArray& ByteArray)
+void QGuiSocket::OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& ByteArray)
 {
-	if (Action == "VOLUME" || Action == "BITMAP")
-	{
-		// qDebug() << "Received" << Action.toLower();
-
-		this->SaveResource(ByteArray);
-		this->RendererServer->SendDataToAll(Action, ByteArray);
-	}
-
-	if (Action == "CAMERA")
-	{
-		this->RendererServer->SendDataToAll(Action, ByteArray);
-	}
+	if (!this->Session)
+		return;
+
+	this->Session->OnReceiveGuiData(Opcode, ByteArray);
+}
+
+void QGuiSocket::OnDisconnected()
+{
+	if (!this->Session)
+		return;
+
+	this->RendererServer->RemoveSession(this->Session);
+
+	this->Session = 0;
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 using namespace ExposureRender;
 
 class QRendererServer;
+class QSession;
 
 class QGuiSocket : public QBaseSocket
 {
@@ -18,13 +19,17 @@ public:
     QGuiSocket(int SocketDescriptor, QRendererServer* RendererServer, QObject* Parent = 0);
 	virtual ~QGuiSocket();
 
-	void OnReceiveData(const QString& Action, QByteArray& ByteArray);
+	void OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& ByteArray);
 
 signals:
 
+private slots:
+	void OnDisconnected();
+
 private:
 	QSettings			Settings;
 	QRendererServer*	RendererServer;
+	QSession*			Session;
 
 friend class QServer;
 };
\ No newline at end of file
@@ -1,17 +1,53 @@
 
 #include "renderersocket.h"
-#include "server\guiserver.h"
+#include "server\session.h"
+#include "socket\guisocket.h"
 
 #include <time.h>
 
 #include <QImage>
+#include <QElapsedTimer>
+#include <QtConcurrentRun>
 
-QRendererSocket::QRendererSocket(int SocketDescriptor, QGuiServer* GuiServer, QObject* Parent /*= 0*/) :
+QRendererSocket::QRendererSocket(int SocketDescriptor, QObject* Parent /*= 0*/) :
 	QBaseSocket(Parent),
 	Settings("compositor.ini", QSettings::IniFormat),
-	GuiServer(GuiServer),
-	Estimate()
+	Session(0),
+	SessionID(0),
+	Estimates(),
+	Estimate(&Estimates[0]),
+	Decoded(&Estimates[1]),
+	PendingData(),
+	Decoding(false),
+	DecodedReady(false),
+	StaleEstimate(false),
+	Combining(false),
+	NoSupersededEstimates(0),
+	NoStaleEstimates(0),
+	DecodeWatcher(),
+	FirstTileRow(0),
+	NoTileRows(0),
+	BrickAxis(0),
+	BrickMin(0),
+	BrickMax(0),
+	Throughput(),
+	PrevNoEstimates(0),
+	PrevEstimateTime(),
+	Device(),
+	SamplesPerSecond(0.0f),
+	RenderTime(0.0f),
+	EncodeTime(0.0f),
+	QueueDepth(0),
+	NoDroppedImages(0),
+	RelayPort(0),
+	LastDecodeTime(0.0f),
+	DecodeTime(),
+	VolumeSender(this)
 {
+	connect(&this->DecodeWatcher, SIGNAL(finished()), this, SLOT(OnDecoded()));
+
+	this->SetSharedMemorySize(this->Settings.value("network/sharedmemory", 64).toInt() * 1024 * 1024);
+
 	if (!this->setSocketDescriptor(SocketDescriptor))
 		return;
 
@@ -22,13 +58,196 @@ QRendererSocket::~QRendererSocket()
 {
 }
 
-void QRendererSocket::OnReceiveData(const QString& Action, QByteArray& Data)
+void QRendererSocket::OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& Data)
+{
+	// qDebug() << Protocol::GetName(Opcode);
+
+	if (Opcode == Protocol::VolumeAck)
+		this->VolumeSender.OnAcknowledge(Data);
+
+	if (Opcode == Protocol::Estimate)
+	{
+		// Estimates still in flight from the previous session of this renderer are dropped before they cost a decode
+		if (QEstimate::GetSessionID(Data) != this->SessionID)
+			return;
+
+		// An estimate of an older view than one already received is of no use to the session, nor to the gui
+		if (this->Session && this->Session->IsStaleEpoch(QEstimate::GetEpoch(Data)))
+		{
+			this->NoStaleEstimates++;
+			return;
+		}
+
+		// Only the latest estimate waits for the decoder, older ones are superseded
+		if (!this->PendingData.isEmpty())
+			this->NoSupersededEstimates++;
+
+		// The payload is a view on the receive buffer, the decoder runs after it has been reused, only the session sends the combined frame to the gui
+		this->PendingData = QByteArray(Data.constData(), Data.size());
+
+		this->StartDecode();
+	}
+
+	if (Opcode == Protocol::RenderStats)
+	{
+		QDataStream DataStream(&Data, QIODevice::ReadOnly);
+		DataStream.setVersion(QDataStream::Qt_4_0);
+
+		DataStream >> this->Device;
+		DataStream >> this->SamplesPerSecond;
+		DataStream >> this->RenderTime;
+		DataStream >> this->EncodeTime;
+		DataStream >> this->QueueDepth;
+		DataStream >> this->NoDroppedImages;
+		DataStream >> this->RelayPort;
+	}
+}
+
+void QRendererSocket::StartDecode()
+{
+	if (this->Decoding || this->DecodedReady || this->PendingData.isEmpty())
+		return;
+
+	QByteArray Data = this->PendingData;
+
+	this->PendingData.clear();
+
+	this->Decoding = true;
+
+	this->DecodeWatcher.setFuture(QtConcurrent::run(this, &QRendererSocket::Decode, Data));
+}
+
+bool QRendererSocket::Decode(QByteArray Data)
+{
+	QElapsedTimer Timer;
+
+	Timer.start();
+
+	const bool Decoded = this->Decoded->FromByteArray(Data);
+
+	this->LastDecodeTime = (float)Timer.nsecsElapsed() / 1000000.0f;
+
+	return Decoded;
+}
+
+void QRendererSocket::OnDecoded()
+{
+	this->Decoding = false;
+
+	this->DecodeTime.PushValue(this->LastDecodeTime);
+
+	// Estimates rendered for the previous session of this renderer are still in flight for a while after a move
+	if (!this->DecodeWatcher.result() || this->Decoded->GetSessionID() != this->SessionID)
+	{
+		this->StartDecode();
+		return;
+	}
+
+	// Another renderer may have delivered a newer view while this estimate was being decoded
+	if (this->Session && this->Session->IsStaleEpoch(this->Decoded->GetEpoch()))
+	{
+		this->NoStaleEstimates++;
+		this->StartDecode();
+		return;
+	}
+
+	if (this->Session)
+		this->Session->UpdateNewestEpoch(this->Decoded->GetEpoch());
+
+	this->DecodedReady = true;
+
+	emit EstimateDecoded();
+}
+
+bool QRendererSocket::PublishEstimate()
+{
+	// A session that is combining this renderer still reads its estimate, even if the renderer was moved to another session meanwhile
+	if (this->Combining)
+		return false;
+
+	if (this->StaleEstimate)
+	{
+		this->Estimate->GetBuffer().Free();
+		this->Estimate->GetOpacity().Free();
+		this->Estimate->GetRadiance().Free();
+		this->Estimate->GetSampleCounts().Free();
+		this->StaleEstimate = false;
+	}
+
+	if (!this->DecodedReady)
+		return false;
+
+	qSwap(this->Estimate, this->Decoded);
+
+	this->DecodedReady = false;
+
+	this->UpdateThroughput();
+	this->StartDecode();
+
+	return true;
+}
+
+void QRendererSocket::SetTileRows(const int& FirstTileRow, const int& NoTileRows)
 {
-	// qDebug() << Action.lower();
+	this->FirstTileRow	= FirstTileRow;
+	this->NoTileRows	= NoTileRows;
+}
 
-	if (Action == "ESTIMATE")
+bool QRendererSocket::HasAssignedCrop(const QRect& Crop)
+{
+	const HostBuffer2D<ColorRGBuc>& Buffer = this->Estimate->GetBuffer();
+
+	return Buffer.Width() == Crop.width() && Buffer.Height() == Crop.height() && this->Estimate->GetOffset()[0] == Crop.x() && this->Estimate->GetOffset()[1] == Crop.y();
+}
+
+void QRendererSocket::SetBrick(const int& Axis, const int& Min, const int& Max)
+{
+	this->BrickAxis	= Axis;
+	this->BrickMin	= Min;
+	this->BrickMax	= Max;
+
+	// Images of the previous brick must not be composited with the new slab order, they are dropped once the combine stage is idle
+	this->StaleEstimate = true;
+}
+
+void QRendererSocket::SetSession(QSession* Session)
+{
+	this->Session	= Session;
+	this->SessionID	= Session ? Session->GetID() : 0;
+
+	// Nothing rendered so far belongs to the new session
+	this->PendingData.clear();
+	this->DecodedReady = false;
+	this->PrevNoEstimates = 0;
+	this->PrevEstimateTime = QTime();
+
+	this->StaleEstimate = true;
+}
+
+bool QRendererSocket::HasBrick() const
+{
+	return this->BrickMax > this->BrickMin;
+}
+
+float QRendererSocket::GetCapacity()
+{
+	// The renderer measures its own sampling rate, the rate observed here also includes network and decode stalls
+	return this->SamplesPerSecond > 0.0f ? this->SamplesPerSecond : this->Throughput.GetAverageValue();
+}
+
+void QRendererSocket::UpdateThroughput()
+{
+	const int NoEstimates = this->Estimate->GetNoEstimates();
+
+	// The estimate count drops whenever the renderer restarts, those intervals are not representative
+	if (this->PrevEstimateTime.isValid() && NoEstimates > this->PrevNoEstimates)
 	{
-		if (this->Estimate.FromByteArray(Data))
-			this->GuiServer->SendDataToAll(Action, Data);
+		const int Elapsed = this->PrevEstimateTime.elapsed();
+
+		if (Elapsed > 0)
+			this->Throughput.PushValue(1000.0f * (float)(NoEstimates - this->PrevNoEstimates) * (float)this->Estimate->GetBuffer().GetNoElements() / (float)Elapsed);
 	}
+
+	this->PrevNoEstimates = NoEstimates;
+	this->PrevEstimateTime.start();
 }
\ No newline at end of file
@@ -2,26 +2,82 @@
 
 #include "utilities\network\basesocket.h"
 #include "utilities\general\estimate.h"
+#include "utilities\general\hysteresis.h"
+#include "utilities\network\volumetransfer.h"
 
 #include <QDebug>
 #include <QSettings>
+#include <QTime>
+#include <QRect>
+#include <QFutureWatcher>
 
-class QGuiServer;
+class QSession;
 
 class QRendererSocket : public QBaseSocket
 {
     Q_OBJECT
 
 public:
-    QRendererSocket(int SocketDescriptor, QGuiServer* GuiServer, QObject* Parent = 0);
+    QRendererSocket(int SocketDescriptor, QObject* Parent = 0);
 	virtual ~QRendererSocket();
 
-	void OnReceiveData(const QString& Action, QByteArray& Data);
+	void OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& Data);
+
+	void SetTileRows(const int& FirstTileRow, const int& NoTileRows);
+	bool HasAssignedCrop(const QRect& Crop);
+	void SetBrick(const int& Axis, const int& Min, const int& Max);
+	bool HasBrick() const;
+	bool PublishEstimate();
+	float GetCapacity();
+	QSession* GetSession() { return this->Session; }
+	void SetSession(QSession* Session);
+
+signals:
+	void EstimateDecoded();
+
+private slots:
+	void OnDecoded();
+
+private:
+	void StartDecode();
+	bool Decode(QByteArray Data);
+	void UpdateThroughput();
 
 private:
 	QSettings		Settings;
-	QGuiServer*		GuiServer;
-	QEstimate		Estimate;
+	QSession*		Session;
+	int				SessionID;
+	QEstimate		Estimates[2];
+	QEstimate*		Estimate;
+	QEstimate*		Decoded;
+	QByteArray		PendingData;
+	bool			Decoding;
+	bool			DecodedReady;
+	bool			StaleEstimate;
+	bool			Combining;
+	int				NoSupersededEstimates;
+	int				NoStaleEstimates;
+	QFutureWatcher<bool>	DecodeWatcher;
+	int				FirstTileRow;
+	int				NoTileRows;
+	int				BrickAxis;
+	int				BrickMin;
+	int				BrickMax;
+	QHysteresis		Throughput;
+	int				PrevNoEstimates;
+	QTime			PrevEstimateTime;
+	QString			Device;
+	float			SamplesPerSecond;
+	float			RenderTime;
+	float			EncodeTime;
+	int				QueueDepth;
+	quint32			NoDroppedImages;
+	quint16			RelayPort;
+	float			LastDecodeTime;
+	QHysteresis		DecodeTime;
+	QVolumeSender	VolumeSender;
 
 friend class QRendererServer;
+friend class QSession;
+friend class QCompositorWindow;
 };
\ No newline at end of file
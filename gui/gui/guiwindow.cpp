@@ -5,6 +5,7 @@
 #include "gui\camerawidget.h"
 
 #include <QtGui>
+#include <QtConcurrentRun>
 
 QGuiWindow::QGuiWindow(QCompositorSocket* CompositorSocket, QWidget* Parent /*= 0*/, Qt::WindowFlags WindowFlags /*= 0*/) :
 	QMainWindow(Parent, WindowFlags),
@@ -14,7 +15,9 @@ QGuiWindow::QGuiWindow(QCompositorSocket* CompositorSocket, QWidget* Parent /*=
 	MainLayout(0),
 	RenderOutputWidget(),
 	UploadVolume(0),
-	UploadBitmap(0)
+	UploadBitmap(0),
+	VolumeFile(0),
+	VolumeHashWatcher()
 {
 	setWindowTitle(tr("Exposure Render GUI"));
 
@@ -44,12 +47,17 @@ QGuiWindow::QGuiWindow(QCompositorSocket* CompositorSocket, QWidget* Parent /*=
 
 	connect(this->UploadVolume, SIGNAL(clicked()), this, SLOT(OnUploadVolume()));
 	connect(this->UploadBitmap, SIGNAL(clicked()), this, SLOT(OnUploadBitmap()));
+	connect(&this->VolumeHashWatcher, SIGNAL(finished()), this, SLOT(OnVolumeHashed()));
 
 	connect(this->RenderOutputWidget, SIGNAL(CameraUpdate(float*, float*, float*)), this, SLOT(OnCameraUpdate(float*, float*, float*)));
 }
 
 QGuiWindow::~QGuiWindow()
 {
+	// The hash reads the file on the thread pool, it has to finish before the file goes
+	this->VolumeHashWatcher.waitForFinished();
+
+	delete this->VolumeFile;
 }
 
 void QGuiWindow::OnTimer()
@@ -59,46 +67,55 @@ void QGuiWindow::OnTimer()
 
 void QGuiWindow::OnUploadVolume()
 {
-	/*
-	QString FileName = "C://workspaces//manix.raw";
-
-	QFile File(FileName);
+	QFile* File = new QFile(this->Settings.value("volume/filename", "C://workspaces//manix.raw").toString());
 
-	if (File.open(QIODevice::ReadOnly))
+	if (!File->open(QIODevice::ReadOnly))
 	{
-		char* Temp = (char*)malloc(File.size());
+		qDebug() << "Unable to send volume!";
 
-		memset(Temp, 0, File.size());
+		delete File;
+		return;
+	}
 
-		File.read(Temp, File.size());
+	// The volume is known by its content, the compositor skips the upload of a volume it has cached and resumes one it has partly received
+	// Hashing reads the entire file, so it runs on the thread pool and the upload starts once it is done
+	QByteArray (*GetHash)(QIODevice*) = &QResourceCache::GetHash;
 
-		QByteArray Voxels(Temp, File.size());
-	
-		QByteArray ByteArray;
-		QDataStream DataStream(&ByteArray, QIODevice::WriteOnly);
-		DataStream.setVersion(QDataStream::Qt_4_0);
+	this->VolumeFile = File;
 
-		QFileInfo FileInfo(File);
+	this->UploadVolume->setEnabled(false);
 
-		DataStream << FileInfo.fileName();
-		
-		DataStream << 256;
-		DataStream << 230;
-		DataStream << 256;
-
-		DataStream << 1.0f;
-		DataStream << 1.0f;
-		DataStream << 1.0f;
-		
-		DataStream << Voxels;
-	
-		this->CompositorSocket->SendData("VOLUME", ByteArray);
-	}
-	else
-	{
-		qDebug() << "Unable to send volume!";
-	}
-	*/
+	this->VolumeHashWatcher.setFuture(QtConcurrent::run(GetHash, (QIODevice*)File));
+}
+
+void QGuiWindow::OnVolumeHashed()
+{
+	QFile* File = this->VolumeFile;
+
+	this->VolumeFile = 0;
+
+	this->UploadVolume->setEnabled(true);
+
+	QFileInfo FileInfo(*File);
+
+	QVolumeInfo Info;
+
+	Info.Hash		= this->VolumeHashWatcher.result();
+	Info.ID			= qFromLittleEndian<quint32>((const uchar*)Info.Hash.constData());
+	Info.FileName	= FileInfo.fileName();
+	Info.NoBytes	= File->size();
+	Info.ChunkSize	= this->Settings.value("volume/chunksize", 1048576).toInt();
+	Info.Compressed	= this->Settings.value("volume/compress", true).toBool();
+
+	Info.Resolution[0]	= this->Settings.value("volume/width", 256).toInt();
+	Info.Resolution[1]	= this->Settings.value("volume/height", 230).toInt();
+	Info.Resolution[2]	= this->Settings.value("volume/depth", 256).toInt();
+
+	for (int i = 0; i < 3; i++)
+		Info.Spacing[i] = this->Settings.value("volume/spacing", 1.0f).toFloat();
+
+	// The file is read a chunk at a time as the compositor acknowledges them, it is never loaded as a whole
+	this->CompositorSocket->VolumeSender.Start(Info, File);
 }
 
 void QGuiWindow::OnUploadBitmap()
@@ -120,7 +137,7 @@ void QGuiWindow::OnUploadBitmap()
 		DataStream << FileInfo.fileName();
 		DataStream << Voxels;
 	
-		this->CompositorSocket->SendData("BITMAP", ByteArray);
+		this->CompositorSocket->SendData(Protocol::Bitmap, ByteArray);
 	}
 	else
 	{
@@ -146,5 +163,6 @@ void QGuiWindow::OnCameraUpdate(float* Position, float* FocalPoint, float* ViewU
 	DataStream << ViewUp[1];
 	DataStream << ViewUp[2];
 
-	this->CompositorSocket->SendData("CAMERA", Data);
+	// Mouse events arrive far more often than frames, the socket only sends the latest camera per frame interval
+	this->CompositorSocket->SetCamera(Data);
 }
\ No newline at end of file
@@ -6,11 +6,13 @@
 #include <QTreeWidget>
 #include <QTreeWidgetItem>
 #include <QtNetwork>
+#include <QFutureWatcher>
 
 class QCompositorSocket;
 class QInteractionWidget;
 class QRenderOutputWidget;
 class QPushButton;
+class QFile;
 
 class QGuiWindow : public QMainWindow
 {
@@ -28,6 +30,7 @@ public:
 public slots:
 	void OnTimer();
 	void OnUploadVolume();
+	void OnVolumeHashed();
 	void OnUploadBitmap();
 	void OnCameraUpdate(float* Position, float* FocalPoint, float* ViewUp);
 
@@ -40,4 +43,6 @@ private:
 	QTimer						Timer;
 	QPushButton*				UploadVolume;
 	QPushButton*				UploadBitmap;
+	QFile*						VolumeFile;
+	QFutureWatcher<QByteArray>	VolumeHashWatcher;
 };
\ No newline at end of file
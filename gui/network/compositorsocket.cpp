@@ -4,20 +4,112 @@
 QCompositorSocket::QCompositorSocket(QObject* Parent /*= 0*/) :
 	QBaseSocket(Parent),
 	Settings("gui.ini", QSettings::IniFormat),
-	Estimate()
+	Estimate(),
+	VolumeSender(this),
+	CameraTimer(),
+	CameraData(),
+	CameraPending(false),
+	ViewEpoch(0),
+	DisplayedEpoch(0),
+	NoStaleEstimates(0)
 {
+	// A compositor on the same host sends the frames uncompressed through shared memory
+	this->SetSharedMemorySize(this->Settings.value("network/sharedmemory", 64).toInt() * 1024 * 1024);
+
+	connect(this, SIGNAL(connected()), this, SLOT(OnConnected()));
+	connect(&this->CameraTimer, SIGNAL(timeout()), this, SLOT(OnSendCamera()));
 }
 
 QCompositorSocket::~QCompositorSocket()
 {
 }
 
-void QCompositorSocket::OnReceiveData(const QString& Action, QByteArray& Data)
+void QCompositorSocket::OnConnected()
 {
-	// qDebug() << Action.lower();
+	QByteArray Data;
+	QDataStream DataStream(&Data, QIODevice::WriteOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	// Every gui has its own session on the compositor, rendered at its own resolution
+	DataStream << this->Settings.value("rendering/imagewidth", 640).toInt();
+	DataStream << this->Settings.value("rendering/imageheight", 480).toInt();
+
+	this->SendData(Protocol::Resolution, Data);
 
-	if (Action == "ESTIMATE")
+	// An upload that was interrupted by the disconnect continues where the compositor left off
+	if (this->VolumeSender.IsBusy())
+		this->VolumeSender.Resume();
+
+	// The new session starts out with the current view
+	if (!this->CameraData.isEmpty())
 	{
+		this->CameraPending = true;
+		this->OnSendCamera();
+	}
+}
+
+void QCompositorSocket::SetCamera(const QByteArray& Data)
+{
+	this->CameraData	= Data;
+	this->CameraPending	= true;
+
+	// The first camera of an interaction goes out at once, the ones after it at most once per frame interval
+	if (this->CameraTimer.isActive())
+		return;
+
+	this->OnSendCamera();
+
+	const int CameraFps = qMax(this->Settings.value("gui/camerafps", 60).toInt(), 1);
+
+	this->CameraTimer.start(1000 / CameraFps);
+}
+
+void QCompositorSocket::OnSendCamera()
+{
+	if (!this->CameraPending)
+	{
+		this->CameraTimer.stop();
+		return;
+	}
+
+	this->CameraPending = false;
+
+	if (this->state() != QAbstractSocket::ConnectedState)
+		return;
+
+	QByteArray Data = this->CameraData;
+
+	QDataStream DataStream(&Data, QIODevice::WriteOnly | QIODevice::Append);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	// Every view gets the next epoch, estimates of earlier views are dropped all the way back to the renderers
+	DataStream << ++this->ViewEpoch;
+
+	this->SendData(Protocol::Camera, Data);
+}
+
+void QCompositorSocket::OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& Data)
+{
+	// qDebug() << Protocol::GetName(Opcode);
+
+	if (Opcode == Protocol::Estimate)
+	{
+		// A frame the compositor combined before it saw the latest view never replaces one of that view
+		const quint32 Epoch = QEstimate::GetEpoch(Data);
+
+		if (Epoch < this->DisplayedEpoch)
+		{
+			this->NoStaleEstimates++;
+
+			qDebug() << "Dropped estimate of view" << Epoch << "behind displayed view" << this->DisplayedEpoch << "," << this->NoStaleEstimates << "dropped in total";
+			return;
+		}
+
+		this->DisplayedEpoch = Epoch;
+
 		this->Estimate.FromByteArray(Data);
 	}
+
+	if (Opcode == Protocol::VolumeAck)
+		this->VolumeSender.OnAcknowledge(Data);
 }
\ No newline at end of file
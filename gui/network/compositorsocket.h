@@ -2,8 +2,10 @@
 
 #include "utilities\network\basesocket.h"
 #include "utilities\general\estimate.h"
+#include "utilities\network\volumetransfer.h"
 
 #include <QSettings>
+#include <QTimer>
 
 class QCompositorSocket : public QBaseSocket
 {
@@ -13,12 +15,25 @@ public:
     QCompositorSocket(QObject* Parent = 0);
 	virtual ~QCompositorSocket();
 
+	void SetCamera(const QByteArray& Data);
+
 protected:
-	void OnReceiveData(const QString& Action, QByteArray& Data);
+	void OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& Data);
+
+private slots:
+	void OnConnected();
+	void OnSendCamera();
 
 private:
 	QSettings		Settings;
 	QEstimate		Estimate;
+	QVolumeSender	VolumeSender;
+	QTimer			CameraTimer;
+	QByteArray		CameraData;
+	bool			CameraPending;
+	quint32			ViewEpoch;
+	quint32			DisplayedEpoch;
+	int				NoStaleEstimates;
 
 friend class QGuiWindow;
 };
\ No newline at end of file
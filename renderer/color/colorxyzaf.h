@@ -139,6 +139,23 @@ public:
 		for (int i = 0; i < 3; i++)
 			this->D[i] = ExposureRender::Clamp(1.0f - expf(-this->D[i] * InvExposure), 0.0f, 1.0f);
 	}
+
+	/*! Tone maps the color with a look up table instead of evaluating expf per channel, the linear interpolation error stays well below one 8-bit step
+		@param Exposure Exposure
+		@param LUT TONE_MAP_LUT_SIZE + 1 samples of 1 - exp(-x), evenly spaced over [0, TONE_MAP_LUT_RANGE]
+	*/
+	HOST_DEVICE void ToneMap(const float& Exposure, const float* LUT)
+	{
+		const float Scale = (float)TONE_MAP_LUT_SIZE / (TONE_MAP_LUT_RANGE * Exposure);
+
+		for (int i = 0; i < 3; i++)
+		{
+			const float T = ExposureRender::Clamp(this->D[i] * Scale, 0.0f, (float)TONE_MAP_LUT_SIZE);
+			const int I = ExposureRender::Min((int)T, TONE_MAP_LUT_SIZE - 1);
+
+			this->D[i] = ExposureRender::Clamp(LUT[I] + (T - (float)I) * (LUT[I + 1] - LUT[I]), 0.0f, 1.0f);
+		}
+	}
 	
 	/*! Test whether the color is black
 		@return Black
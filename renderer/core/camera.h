@@ -19,10 +19,34 @@
 #include "core\film.h"
 #include "core\rng.h"
 #include "geometry\montecarlo.h"
+#include "geometry\boundingbox.h"
 
 namespace ExposureRender
 {
 
+/*! Snapshot of the camera basis and screen window, used to reproject estimates from a previous view */
+class EXPOSURE_RENDER_DLL CameraView
+{
+public:
+	/*! Computes the normalized direction of the ray through film position \a ImageUV
+		@param[in] ImageUV Position on the film plane
+		@return Ray direction
+	*/
+	HOST_DEVICE Vec3f GetDirection(const Vec2f& ImageUV) const
+	{
+		const Vec2f ScreenPoint(this->Screen[0][0] + (this->InvScreen[0] * ImageUV[0]), this->Screen[1][0] + (this->InvScreen[1] * ImageUV[1]));
+
+		return Normalize(this->N + (ScreenPoint[0] * this->U) - (ScreenPoint[1] * this->V));
+	}
+
+	Vec3f		Pos;				/*! Camera position */
+	Vec3f		N;					/*! Camera normal vector */
+	Vec3f		U;					/*! Camera U vector */
+	Vec3f		V;					/*! Camera V vector */
+	float		Screen[2][2];		/*! Screen window */
+	float		InvScreen[2];		/*! Screen window per pixel */
+};
+
 /*! Camera class */
 class EXPOSURE_RENDER_DLL Camera
 {
@@ -103,6 +127,26 @@ public:
 		}
 	}
 
+	/*! Samples the camera through the center of pixel \a UV, without lens jitter (used by standard ray casting)
+		@param[in,out] R Sampled ray
+		@param[in] UV Position on the film plane
+	*/
+	HOST_DEVICE void SampleCenter(Ray& R, const Vec2i& UV) const
+	{
+		Vec2f ScreenPoint;
+
+		R.ImageUV[0] = UV[0] + 0.5f;
+		R.ImageUV[1] = UV[1] + 0.5f;
+
+		ScreenPoint[0] = this->Film.Screen[0][0] + (this->Film.InvScreen[0] * R.ImageUV[0]);
+		ScreenPoint[1] = this->Film.Screen[1][0] + (this->Film.InvScreen[1] * R.ImageUV[1]);
+
+		R.O		= this->Pos;
+		R.D		= Normalize(this->N + (ScreenPoint[0] * this->U) - (ScreenPoint[1] * this->V));
+		R.MinT	= -1000.0f;
+		R.MaxT	= 1000.0f;
+	}
+
 	/*! Projects a point \a P in world space onto the camera film plane
 		@param[in] P Point in world space
 		@param[out] FilmUV Position on the film plane
@@ -110,29 +154,78 @@ public:
 	*/
 	HOST_DEVICE bool ProjectPointToFilmPlane(const Vec3f& P, Vec2f& FilmUV) const
 	{
-		const Vec3f D = P - this->Pos;
-		const Vec3f Dn = Normalize(P - this->Pos);
+		if (!this->ProjectPointToScreen(P, FilmUV))
+			return false;
 
-		const float L = Dot(Dn, this->N);
+		if (FilmUV[0] < 0.0f || FilmUV[0] > (float)this->Film.GetResolution()[0])
+			return false;
 
-		const Vec3f FilmP = this->Pos + Dn * (1.0f * L);
+		if (FilmUV[1] < 0.0f || FilmUV[1] > (float)this->Film.GetResolution()[1])
+			return false;
 
-		const Vec2f CamUV(Dot(FilmP, this->U), -Dot(FilmP, this->V));
+		return true;
+	}
 
-		if (CamUV[0] < this->Film.Screen[0][0] || CamUV[0] > this->Film.Screen[0][1])
-			return false;
+	/*! Projects a point \a P in world space onto the (infinite) camera film plane, the inverse of Sample()
+		@param[in] P Point in world space
+		@param[out] FilmUV Position on the film plane, possibly outside the film
+		@return Whether \a P lies in front of the camera
+	*/
+	HOST_DEVICE bool ProjectPointToScreen(const Vec3f& P, Vec2f& FilmUV) const
+	{
+		const Vec3f D = P - this->Pos;
+
+		const float Depth = Dot(D, this->N);
 
-		if (CamUV[1] < this->Film.Screen[1][0] || CamUV[1] > this->Film.Screen[1][1])
+		if (Depth <= 0.0f)
 			return false;
 
-		const Vec2f ScreenSize(this->Film.Screen[0][1] - this->Film.Screen[0][0], this->Film.Screen[1][1] - this->Film.Screen[1][0]);
+		const Vec2f ScreenPoint(Dot(D, this->U) / Depth, -Dot(D, this->V) / Depth);
 
-		Vec2f Offset = CamUV - Vec2f(this->Film.Screen[0][0], this->Film.Screen[1][0]);
-		
-		Offset /= ScreenSize;
-		
-		FilmUV[0] = (float)this->Film.GetResolution()[0] * Offset[0];
-		FilmUV[1] = (float)this->Film.GetResolution()[1] * Offset[1];
+		FilmUV[0] = (ScreenPoint[0] - this->Film.Screen[0][0]) / this->Film.InvScreen[0];
+		FilmUV[1] = (ScreenPoint[1] - this->Film.Screen[1][0]) / this->Film.InvScreen[1];
+
+		return true;
+	}
+
+	/*! Computes the pixel rectangle covered by bounding box \a B on the film plane
+		@param[in] B Bounding box in world space
+		@param[out] Min Minimum pixel coordinates
+		@param[out] Max Maximum pixel coordinates
+		@return Whether the projected bounding box overlaps the film
+	*/
+	HOST bool ProjectBoundingBoxToFilmPlane(const BoundingBox& B, Vec2i& Min, Vec2i& Max) const
+	{
+		const Vec3f MinP = B.GetMinP();
+		const Vec3f MaxP = B.GetMaxP();
+
+		Vec2f Range[2] = { Vec2f(FLT_MAX, FLT_MAX), Vec2f(-FLT_MAX, -FLT_MAX) };
+
+		for (int i = 0; i < 8; i++)
+		{
+			const Vec3f Corner(i & 1 ? MaxP[0] : MinP[0], i & 2 ? MaxP[1] : MinP[1], i & 4 ? MaxP[2] : MinP[2]);
+
+			Vec2f FilmUV;
+
+			// A corner behind the camera can project anywhere, so conservatively cover the entire film
+			if (!this->ProjectPointToScreen(Corner, FilmUV))
+			{
+				Min = Vec2i(0, 0);
+				Max = this->Film.GetResolution() - Vec2i(1, 1);
+				return true;
+			}
+
+			Range[0] = Range[0].Min(FilmUV);
+			Range[1] = Range[1].Max(FilmUV);
+		}
+
+		const Vec2i Resolution = this->Film.GetResolution();
+
+		if (Range[1][0] < 0.0f || Range[1][1] < 0.0f || Range[0][0] >= (float)Resolution[0] || Range[0][1] >= (float)Resolution[1])
+			return false;
+
+		Min = Vec2i(Clamp((int)floorf(Range[0][0]), 0, Resolution[0] - 1), Clamp((int)floorf(Range[0][1]), 0, Resolution[1] - 1));
+		Max = Vec2i(Clamp((int)ceilf(Range[1][0]), 0, Resolution[0] - 1), Clamp((int)ceilf(Range[1][1]), 0, Resolution[1] - 1));
 
 		return true;
 	}
@@ -166,6 +259,28 @@ public:
 			this->FocalDistance = Length(this->Target, this->Pos);
 	}
 
+	/*! Returns a snapshot of the current view, valid after Update()
+		@return Camera view
+	*/
+	HOST_DEVICE CameraView GetView() const
+	{
+		CameraView View;
+
+		View.Pos	= this->Pos;
+		View.N		= this->N;
+		View.U		= this->U;
+		View.V		= this->V;
+
+		for (int i = 0; i < 2; i++)
+		{
+			View.Screen[i][0]	= this->Film.Screen[i][0];
+			View.Screen[i][1]	= this->Film.Screen[i][1];
+			View.InvScreen[i]	= this->Film.InvScreen[i];
+		}
+
+		return View;
+	}
+
 	/*! Returns the film
 		@return Film
 	*/
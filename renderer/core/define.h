@@ -42,6 +42,8 @@ namespace ExposureRender
 #define RAY_EPS_2					2.0f * RAY_EPS
 #define MAX_CHAR_SIZE				255
 #define ONE_OVER_255				1.0f / 255.0f
+#define TONE_MAP_LUT_SIZE			256
+#define TONE_MAP_LUT_RANGE			16.0f
 
 #ifdef __CUDACC__
 	#define KERNEL						__global__
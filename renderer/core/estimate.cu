@@ -3,6 +3,7 @@
 #include "core\cudawrapper.h"
 #include "core\renderer.h"
 #include "core\intersect.cuh"
+#include "core\gradient.h"
 
 namespace ExposureRender
 {
@@ -14,6 +15,9 @@ KERNEL void KrnlEstimate(Renderer* Renderer)
 
 	if (X >= Renderer->Camera.GetFilm().GetWidth() || Y >= Renderer->Camera.GetFilm().GetHeight())
 		return;
+
+	if (!Renderer->Camera.GetFilm().IsTileActive(X, Y))
+		return;
 	
 	CudaBuffer2D<ColorXYZAf>& IterationEstimateHDR = Renderer->Camera.GetFilm().GetIterationEstimateHDR();
 
@@ -25,10 +29,47 @@ KERNEL void KrnlEstimate(Renderer* Renderer)
 
 	ScatterEvent SE;
 
+	// Feature buffers: the depth is needed to reproject the estimate when the camera moves, depth, normals and albedo guide the denoiser
+	CudaBuffer2D<float>& Depth			= Renderer->Camera.GetFilm().GetDepth();
+	CudaBuffer2D<Vec3f>& Normals		= Renderer->Camera.GetFilm().GetNormals();
+	CudaBuffer2D<ColorXYZf>& Albedo		= Renderer->Camera.GetFilm().GetAlbedo();
+
+	const int NoEstimates = Renderer->Camera.GetFilm().GetNoEstimates(X, Y);
+
 	if (IntersectVolume(Renderer->Volume, R, Random, SE))
+	{
 		IterationEstimateHDR.Set(X, Y, ColorXYZAf(1.0f, 1.0f, 1.0f, 0.0f));
+
+		Depth.Set(X, Y, Depth(X, Y) > 0.0f ? CumulativeMovingAverage(Depth(X, Y), SE.GetT(), NoEstimates) : SE.GetT());
+
+		if (Renderer->Camera.GetFilm().GetFeatures())
+		{
+			Vec3f Normal = Gradient(Renderer->Volume, SE.GetP(), Renderer->Volume.GetTracer().GetGradientMode());
+
+			if (Normal.LengthSquared() > 0.0f)
+				Normal.Normalize();
+
+			const ColorXYZf Diffuse = Renderer->Volume.GetTracer().GetDiffuse(Renderer->Volume.GetIntensity(SE.GetP()));
+
+			Normals.Set(X, Y, NoEstimates > 1 ? CumulativeMovingAverage(Normals(X, Y), Normal, NoEstimates) : Normal);
+			Albedo.Set(X, Y, NoEstimates > 1 ? CumulativeMovingAverage(Albedo(X, Y), Diffuse, NoEstimates) : Diffuse);
+		}
+	}
 	else
+	{
 		IterationEstimateHDR.Set(X, Y, ColorXYZAf(0.0f, 0.0f, 0.0f, 0.0f));
+
+		if (NoEstimates == 1)
+		{
+			Depth.Set(X, Y, 0.0f);
+
+			if (Renderer->Camera.GetFilm().GetFeatures())
+			{
+				Normals.Set(X, Y, Vec3f());
+				Albedo.Set(X, Y, ColorXYZf());
+			}
+		}
+	}
 	/*
 	if (BB.Intersect(R, R.MinT, R.MaxT))
 		IterationEstimateHDR.Set(X, Y, ColorXYZAf(1.0f, 1.0f, 1.0f, 0.0f));
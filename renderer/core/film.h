@@ -23,6 +23,8 @@
 namespace ExposureRender
 {
 
+#define FILM_TILE_SIZE		16
+
 /*! Film class */
 class EXPOSURE_RENDER_DLL Film
 {
@@ -32,27 +34,53 @@ public:
 	*/
 	HOST Film(const Vec2i& Resolution) :
 		Resolution(),
+		FullResolution(Resolution),
+		Offset(0, 0),
 		IterationEstimateHDR(),
-		IterationEstimateLDR(),
-		IterationEstimateTempFilterLDR(),
 		AccumulatedEstimate(),
 		CudaRunningEstimate(),
 		HostRunningEstimate(),
 		RandomSeeds1(),
 		RandomSeeds2(),
-		HostRandomSeeds1(),
-		HostRandomSeeds2(),
+		TileOffsets(),
+		HostTileOffsets(),
+		TileOffsetsDirty(false),
+		TilePriorities(),
+		TileCredits(),
+		ActiveTiles(),
+		HostActiveTiles(),
+		AdaptiveSampling(false),
+		Depth(),
+		ReprojectedDepth(),
+		Normals(),
+		Albedo(),
+		HostDepth(),
+		HostNormals(),
+		HostAlbedo(),
+		CudaRunningOpacity(),
+		HostRunningOpacity(),
+		AccumulatedRadiance(),
+		HostAccumulatedRadiance(),
+		Features(false),
+		OutputOpacity(false),
+		OutputRadiance(false),
+		ClearAccumulation(true),
 		NoEstimates(1),
 		Exposure(1.0f),
 		InvExposure(1.0f),
 		Gamma(2.2f),
-		InvGamma(1.0f / 2.2f)
+		InvGamma(1.0f / 2.2f),
+		ReprojectionWeight(0.5f),
+		MaxReprojectionWeight(16.0f)
 	{
 		this->Resize(Resolution);
 
 		this->GaussianFilterWeights[0]	= 1.0f * 0.24197072451914536f;
 		this->GaussianFilterWeights[1]	= 2.0f * 0.39894228040143270f;
 		this->GaussianFilterWeights[2]	= 1.0f * 0.24197072451914536f;
+
+		for (int i = 0; i <= TONE_MAP_LUT_SIZE; i++)
+			this->ToneMapLUT[i] = 1.0f - expf(-(float)i * TONE_MAP_LUT_RANGE / (float)TONE_MAP_LUT_SIZE);
 	}
 
 	/*! Resize the film
@@ -66,27 +94,178 @@ public:
 		this->Resolution = Resolution;
 
 		this->IterationEstimateHDR.Resize(this->Resolution);
-		this->IterationEstimateLDR.Resize(this->Resolution);
-		this->IterationEstimateTempFilterLDR.Resize(this->Resolution);
 		this->AccumulatedEstimate.Resize(this->Resolution);
 		this->CudaRunningEstimate.Resize(this->Resolution);
 		this->HostRunningEstimate.Resize(this->Resolution);
 		this->RandomSeeds1.Resize(this->Resolution);
 		this->RandomSeeds2.Resize(this->Resolution);
-		this->HostRandomSeeds1.Resize(this->Resolution);
-		this->HostRandomSeeds2.Resize(this->Resolution);
-		
-		this->RandomSeeds1.FromHost(this->HostRandomSeeds1.GetData());
-		this->RandomSeeds2.FromHost(this->HostRandomSeeds2.GetData());
+
+		const Vec2i NoTiles((int)ceilf((float)this->Resolution[0] / (float)FILM_TILE_SIZE), (int)ceilf((float)this->Resolution[1] / (float)FILM_TILE_SIZE));
+
+		this->TileOffsets.Resize(NoTiles);
+		this->HostTileOffsets.Resize(NoTiles);
+
+		this->ResizeAdaptiveBuffers();
+
+		this->Depth.Resize(this->Resolution);
+		this->ReprojectedDepth.Resize(this->Resolution);
+
+		this->ResizeFeatureBuffers();
+		this->ResizeOpacityBuffers();
+		this->ResizeRadianceBuffers();
+
+		// The seeds only need to live on the device, the random number generators advance them in place
+		HostRandomSeedBuffer2D HostRandomSeeds;
+
+		HostRandomSeeds.Resize(this->Resolution);
+		this->RandomSeeds1.FromHost(HostRandomSeeds.GetData());
+
+		for (int i = 0; i < HostRandomSeeds.GetNoElements(); i++)
+			HostRandomSeeds[i] = rand();
+
+		this->RandomSeeds2.FromHost(HostRandomSeeds.GetData());
 
 		this->Grid[0] = (int)ceilf((float)this->Resolution[0] / (float)this->Block[0]);
 		this->Grid[1] = (int)ceilf((float)this->Resolution[1] / (float)this->Block[1]);
 	}
 
-	/*! Restarts the mc algorithm */
-	HOST void Restart()
+	/*! Restricts the film to a crop of a larger frame, used when the frame is distributed over several renderers
+		@param[in] FullResolution Resolution of the entire frame
+		@param[in] Offset Position of the crop in the frame
+		@param[in] Resolution Resolution of the crop
+	*/
+	HOST void SetCrop(const Vec2i& FullResolution, const Vec2i& Offset, const Vec2i& Resolution)
+	{
+		this->FullResolution	= FullResolution;
+		this->Offset			= Offset;
+
+		this->Resize(Resolution);
+		this->Restart();
+	}
+
+	/*! Restarts the mc algorithm
+		@param[in] Reprojected Whether the accumulation buffer was seeded with a reprojected estimate, in which case it is not cleared
+	*/
+	HOST void Restart(const bool& Reprojected = false)
+	{
+		this->NoEstimates		= 1;
+		this->ClearAccumulation	= !Reprojected;
+
+		this->HostTileOffsets.Reset();
+		this->TileOffsetsDirty = true;
+	}
+
+	/*! Restarts the mc algorithm only for the tiles that overlap the pixel range [\a Min, \a Max], the remaining tiles keep converging
+		@param[in] Min Minimum pixel coordinates of the dirty region
+		@param[in] Max Maximum pixel coordinates of the dirty region
+	*/
+	HOST void RestartRegion(const Vec2i& Min, const Vec2i& Max)
+	{
+		if (this->NoEstimates == 1)
+			return;
+
+		const Vec2i NoTiles = this->HostTileOffsets.GetResolution();
+
+		const int TileRange[2][2] =
+		{
+			{ Clamp(Min[0] / FILM_TILE_SIZE, 0, NoTiles[0] - 1), Clamp(Max[0] / FILM_TILE_SIZE, 0, NoTiles[0] - 1) },
+			{ Clamp(Min[1] / FILM_TILE_SIZE, 0, NoTiles[1] - 1), Clamp(Max[1] / FILM_TILE_SIZE, 0, NoTiles[1] - 1) }
+		};
+
+		for (int TileY = TileRange[1][0]; TileY <= TileRange[1][1]; TileY++)
+			for (int TileX = TileRange[0][0]; TileX <= TileRange[0][1]; TileX++)
+				this->HostTileOffsets(TileX, TileY) = this->NoEstimates - 1;
+
+		this->TileOffsetsDirty = true;
+	}
+
+	/*! Sets per tile sampling priorities, a tile with priority p is sampled in a fraction p of the estimates, so the sample budget goes where the image is still noisy
+		@param[in] Priorities Priorities in [0, 1] at the tile resolution of the film, an empty buffer samples all tiles uniformly
+	*/
+	HOST void SetTilePriorities(const HostBuffer2D<float>& Priorities)
+	{
+		this->AdaptiveSampling = !Priorities.IsEmpty() && Priorities.GetResolution() == this->HostTileOffsets.GetResolution();
+
+		this->ResizeAdaptiveBuffers();
+
+		if (this->AdaptiveSampling)
+			this->TilePriorities = Priorities;
+	}
+
+	/*! Decides which tiles are sampled in the upcoming estimate, tiles without samples always are. Skipped tiles have their offset advanced, so their estimate count stays put
+		Priorities are accumulated as credits (error diffusion), which spreads the samples of a tile evenly over the estimates
+	*/
+	HOST void SelectActiveTiles()
+	{
+		if (!this->AdaptiveSampling)
+			return;
+
+		for (int i = 0; i < this->HostActiveTiles.GetNoElements(); i++)
+		{
+			bool Active = this->NoEstimates - 1 - this->HostTileOffsets[i] <= 0;
+
+			if (!Active)
+			{
+				this->TileCredits[i] += this->TilePriorities[i];
+
+				if (this->TileCredits[i] >= 1.0f)
+				{
+					this->TileCredits[i] -= 1.0f;
+					Active = true;
+				}
+			}
+
+			if (!Active)
+			{
+				this->HostTileOffsets[i]++;
+				this->TileOffsetsDirty = true;
+			}
+
+			this->HostActiveTiles[i] = Active ? 1 : 0;
+		}
+
+		this->ActiveTiles.FromHost(this->HostActiveTiles.GetData());
+	}
+
+	/*! Returns the number of pixels sampled in the current estimate
+		@return Number of sampled pixels
+	*/
+	HOST int GetNoSampledPixels() const
 	{
-		this->NoEstimates = 1;
+		const int NoPixels = this->GetWidth() * this->GetHeight();
+
+		if (!this->AdaptiveSampling)
+			return NoPixels;
+
+		int NoActiveTiles = 0;
+
+		for (int i = 0; i < this->HostActiveTiles.GetNoElements(); i++)
+			NoActiveTiles += this->HostActiveTiles[i];
+
+		const int NoSampledPixels = NoActiveTiles * FILM_TILE_SIZE * FILM_TILE_SIZE;
+
+		return NoSampledPixels < NoPixels ? NoSampledPixels : NoPixels;
+	}
+
+	/*! Returns whether pixel \a X, \a Y is sampled in the current estimate
+		@param[in] X X position on the film plane
+		@param[in] Y Y position on the film plane
+		@return Whether the pixel is sampled
+	*/
+	HOST_DEVICE bool IsTileActive(const int& X, const int& Y) const
+	{
+		return !this->AdaptiveSampling || this->ActiveTiles(X / FILM_TILE_SIZE, Y / FILM_TILE_SIZE) != 0;
+	}
+
+	/*! Copies modified tile offsets to the device, prior to rendering an estimate */
+	HOST void UploadTileOffsets()
+	{
+		if (!this->TileOffsetsDirty)
+			return;
+
+		this->TileOffsets.FromHost(this->HostTileOffsets.GetData());
+
+		this->TileOffsetsDirty = false;
 	}
 
 	/*! Returns the film resolution
@@ -97,6 +276,22 @@ public:
 		return this->Resolution;
 	}
 
+	/*! Returns the resolution of the entire frame, which differs from the film resolution if the film is cropped
+		@return Frame resolution
+	*/
+	HOST_DEVICE Vec2i GetFullResolution() const
+	{
+		return this->FullResolution;
+	}
+
+	/*! Returns the position of the film in the entire frame
+		@return Crop offset
+	*/
+	HOST_DEVICE Vec2i GetOffset() const
+	{
+		return this->Offset;
+	}
+
 	/*! Returns the film width
 		@return Film width
 	*/
@@ -121,26 +316,10 @@ public:
 		return this->IterationEstimateHDR;
 	}
 
-	/*! Returns the ldr iteration estimate
-		@return LDR iteration estimate
-	*/
-	HOST_DEVICE CudaBuffer2D<ColorRGBAuc>& GetIterationEstimateLDR()
-	{
-		return this->IterationEstimateLDR;
-	}
-
-	/*! Returns the filter temporary ldr iteration estimate
-		@return Temporary fitler ldr iteration estimate
-	*/
-	HOST_DEVICE CudaBuffer2D<ColorRGBAuc>& GetIterationEstimateTempFilterLDR()
-	{
-		return this->IterationEstimateTempFilterLDR;
-	}
-
-	/*! Returns the accumulated estimate
+	/*! Returns the accumulated estimate, the sum of the ldr estimates in rgb and the number of virtual (reprojected) estimates the pixel carries on top of its own estimates in alpha
 		@return Accumulated estimate
 	*/
-	HOST_DEVICE CudaBuffer2D<ColorRGBAul>& GetAccumulatedEstimate()
+	HOST_DEVICE CudaBuffer2D<ColorRGBAf>& GetAccumulatedEstimate()
 	{
 		return this->AccumulatedEstimate;
 	}
@@ -161,36 +340,232 @@ public:
 		return this->HostRunningEstimate;
 	}
 
-	/*! Returns the first random seeds buffer
-		@return First random seeds buffer
+	/*! Returns the per tile restart offsets in host memory space
+		@return Host tile offsets
 	*/
-	HOST_DEVICE CudaRandomSeedBuffer2D& GetRandomSeeds1()
+	HOST_DEVICE HostBuffer2D<int>& GetHostTileOffsets()
 	{
-		return this->RandomSeeds1;
+		return this->HostTileOffsets;
 	}
 
-	/*! Returns the second random seeds buffer
-		@return Second random seeds buffer
+	/*! Returns the representative (first scatter) depth per pixel, zero where nothing was hit
+		@return Depth buffer
 	*/
-	HOST_DEVICE CudaRandomSeedBuffer2D& GetRandomSeeds2()
+	HOST_DEVICE CudaBuffer2D<float>& GetDepth()
 	{
-		return this->RandomSeeds2;
+		return this->Depth;
+	}
+
+	/*! Returns the depth buffer used to resolve visibility while reprojecting
+		@return Reprojected depth
+	*/
+	HOST_DEVICE CudaBuffer2D<float>& GetReprojectedDepth()
+	{
+		return this->ReprojectedDepth;
 	}
 
-	/*! Returns the first host random seeds buffer
-		@return First host random seeds buffer
+	/*! Returns the average (unnormalized) gradient direction at the first scatter event per pixel
+		@return Normals buffer
 	*/
-	HOST_DEVICE HostRandomSeedBuffer2D& GetHostRandomSeeds1()
+	HOST_DEVICE CudaBuffer2D<Vec3f>& GetNormals()
 	{
-		return this->HostRandomSeeds1;
+		return this->Normals;
 	}
 
-	/*! Returns the second host random seeds buffer
-		@return Second host random seeds buffer
+	/*! Returns the average diffuse color at the first scatter event per pixel
+		@return Albedo buffer
 	*/
-	HOST_DEVICE HostRandomSeedBuffer2D& GetHostRandomSeeds2()
+	HOST_DEVICE CudaBuffer2D<ColorXYZf>& GetAlbedo()
 	{
-		return this->HostRandomSeeds2;
+		return this->Albedo;
+	}
+
+	/*! Returns the depth buffer in host memory space
+		@return Host depth buffer
+	*/
+	HOST_DEVICE HostBuffer2D<float>& GetHostDepth()
+	{
+		return this->HostDepth;
+	}
+
+	/*! Returns the normals buffer in host memory space
+		@return Host normals buffer
+	*/
+	HOST_DEVICE HostBuffer2D<Vec3f>& GetHostNormals()
+	{
+		return this->HostNormals;
+	}
+
+	/*! Returns the albedo buffer in host memory space
+		@return Host albedo buffer
+	*/
+	HOST_DEVICE HostBuffer2D<ColorXYZf>& GetHostAlbedo()
+	{
+		return this->HostAlbedo;
+	}
+
+	/*! Copies the feature buffers (depth, normals and albedo) to host memory space */
+	HOST void DownloadFeatureBuffers()
+	{
+		if (!this->Features)
+			return;
+
+		Cuda::MemCopyDeviceToHost(this->Depth.GetData(), this->HostDepth.GetData(), this->Depth.GetNoElements());
+		Cuda::MemCopyDeviceToHost(this->Normals.GetData(), this->HostNormals.GetData(), this->Normals.GetNoElements());
+		Cuda::MemCopyDeviceToHost(this->Albedo.GetData(), this->HostAlbedo.GetData(), this->Albedo.GetNoElements());
+	}
+
+	/*! Sets whether the feature buffers for the denoiser are maintained, they are only allocated while enabled
+		@param[in] Features Whether to maintain the feature buffers
+	*/
+	HOST void SetFeatures(const bool& Features)
+	{
+		this->Features = Features;
+		this->ResizeFeatureBuffers();
+	}
+
+	/*! Returns whether the feature buffers for the denoiser are maintained
+		@return Whether the feature buffers are maintained
+	*/
+	HOST_DEVICE bool GetFeatures() const
+	{
+		return this->Features;
+	}
+
+	/*! Returns the opacity of the latest estimate per pixel in cuda memory space
+		@return Cuda opacity buffer
+	*/
+	HOST_DEVICE CudaBuffer2D<unsigned char>& GetCudaRunningOpacity()
+	{
+		return this->CudaRunningOpacity;
+	}
+
+	/*! Returns the opacity of the latest estimate per pixel in host memory space
+		@return Host opacity buffer
+	*/
+	HOST_DEVICE HostBuffer2D<unsigned char>& GetHostRunningOpacity()
+	{
+		return this->HostRunningOpacity;
+	}
+
+	/*! Copies the opacity buffer to host memory space */
+	HOST void DownloadOpacityBuffer()
+	{
+		if (!this->OutputOpacity)
+			return;
+
+		Cuda::MemCopyDeviceToHost(this->CudaRunningOpacity.GetData(), this->HostRunningOpacity.GetData(), this->CudaRunningOpacity.GetNoElements());
+	}
+
+	/*! Sets whether the opacity of each estimate is output, required for sort-last compositing. The opacity buffers are only allocated while enabled
+		@param[in] OutputOpacity Whether to output opacity
+	*/
+	HOST void SetOutputOpacity(const bool& OutputOpacity)
+	{
+		this->OutputOpacity = OutputOpacity;
+		this->ResizeOpacityBuffers();
+	}
+
+	/*! Returns whether the opacity of each estimate is output
+		@return Whether opacity is output
+	*/
+	HOST_DEVICE bool GetOutputOpacity() const
+	{
+		return this->OutputOpacity;
+	}
+
+	/*! Returns the sum of the (not tone mapped) estimates per pixel in cuda memory space
+		@return Cuda radiance buffer
+	*/
+	HOST_DEVICE CudaBuffer2D<ColorXYZf>& GetAccumulatedRadiance()
+	{
+		return this->AccumulatedRadiance;
+	}
+
+	/*! Returns the sum of the (not tone mapped) estimates per pixel in host memory space
+		@return Host radiance buffer
+	*/
+	HOST_DEVICE HostBuffer2D<ColorXYZf>& GetHostAccumulatedRadiance()
+	{
+		return this->HostAccumulatedRadiance;
+	}
+
+	/*! Copies the radiance buffer to host memory space */
+	HOST void DownloadRadianceBuffer()
+	{
+		if (!this->OutputRadiance)
+			return;
+
+		Cuda::MemCopyDeviceToHost(this->AccumulatedRadiance.GetData(), this->HostAccumulatedRadiance.GetData(), this->AccumulatedRadiance.GetNoElements());
+	}
+
+	/*! Sets whether the radiance is accumulated before tone mapping, so a compositor can weigh the estimates of several renderers by their number of samples. The radiance buffers are only allocated while enabled
+		@param[in] OutputRadiance Whether to output radiance
+	*/
+	HOST void SetOutputRadiance(const bool& OutputRadiance)
+	{
+		this->OutputRadiance = OutputRadiance;
+		this->ResizeRadianceBuffers();
+		this->Restart();
+	}
+
+	/*! Returns whether the radiance is accumulated before tone mapping
+		@return Whether radiance is output
+	*/
+	HOST_DEVICE bool GetOutputRadiance() const
+	{
+		return this->OutputRadiance;
+	}
+
+	/*! Returns the number of bytes a film of \a Resolution occupies
+		@param[in] Resolution Film resolution
+		@param[in] Features Whether the feature buffers are maintained
+		@param[in] OutputOpacity Whether the opacity buffers are maintained
+		@param[in] OutputRadiance Whether the radiance buffers are maintained
+		@param[out] DeviceBytes Number of bytes in device memory
+		@param[out] HostBytes Number of bytes in host memory
+	*/
+	HOST static void GetMemorySize(const Vec2i& Resolution, const bool& Features, const bool& OutputOpacity, const bool& OutputRadiance, long long& DeviceBytes, long long& HostBytes)
+	{
+		const long long NoPixels	= (long long)Resolution[0] * (long long)Resolution[1];
+		const long long NoTiles		= (long long)ceilf((float)Resolution[0] / (float)FILM_TILE_SIZE) * (long long)ceilf((float)Resolution[1] / (float)FILM_TILE_SIZE);
+
+		DeviceBytes	= NoPixels * (sizeof(ColorXYZAf) + sizeof(ColorRGBAf) + sizeof(ColorRGBuc) + 2 * sizeof(unsigned int) + 2 * sizeof(float)) + NoTiles * sizeof(int);
+		HostBytes	= NoPixels * sizeof(ColorRGBuc) + NoTiles * sizeof(int);
+
+		if (Features)
+		{
+			DeviceBytes	+= NoPixels * (sizeof(Vec3f) + sizeof(ColorXYZf));
+			HostBytes	+= NoPixels * (sizeof(float) + sizeof(Vec3f) + sizeof(ColorXYZf));
+		}
+
+		if (OutputOpacity)
+		{
+			DeviceBytes	+= NoPixels * sizeof(unsigned char);
+			HostBytes	+= NoPixels * sizeof(unsigned char);
+		}
+
+		if (OutputRadiance)
+		{
+			DeviceBytes	+= NoPixels * sizeof(ColorXYZf);
+			HostBytes	+= NoPixels * sizeof(ColorXYZf);
+		}
+	}
+
+	/*! Returns the first random seeds buffer
+		@return First random seeds buffer
+	*/
+	HOST_DEVICE CudaRandomSeedBuffer2D& GetRandomSeeds1()
+	{
+		return this->RandomSeeds1;
+	}
+
+	/*! Returns the second random seeds buffer
+		@return Second random seeds buffer
+	*/
+	HOST_DEVICE CudaRandomSeedBuffer2D& GetRandomSeeds2()
+	{
+		return this->RandomSeeds2;
 	}
 
 	/*! Returns the gaussian filter weights for a 3 x 3 kernel
@@ -201,6 +576,14 @@ public:
 		return this->GaussianFilterWeights;
 	}
 
+	/*! Returns the tone mapping look up table, TONE_MAP_LUT_SIZE + 1 samples of 1 - exp(-x) over [0, TONE_MAP_LUT_RANGE]
+		@return Tone mapping look up table
+	*/
+	HOST_DEVICE float* GetToneMapLUT()
+	{
+		return this->ToneMapLUT;
+	}
+
 	/*! Returns the random number generator for the specified pixel coordinates
 		@param[in] Pixel Pixel coordinates
 		@return Random number generator
@@ -218,6 +601,16 @@ public:
 		return this->NoEstimates;
 	}
 
+	/*! Returns the no estimates rendered so far for pixel \a X, \a Y, which is lower than GetNoEstimates() if its tile was restarted separately
+		@param[in] X X position on the film plane
+		@param[in] Y Y position on the film plane
+		@return Number of estimates
+	*/
+	HOST_DEVICE int GetNoEstimates(const int& X, const int& Y) const
+	{
+		return this->NoEstimates - this->TileOffsets(X / FILM_TILE_SIZE, Y / FILM_TILE_SIZE);
+	}
+
 	/*! Incrementes the number of estimates rendered so far */
 	HOST_DEVICE void IncrementNoEstimates()
 	{
@@ -230,7 +623,7 @@ public:
 		this->InvExposure	= this->Exposure == 0.0f ? 0.0f : 1.0f / this->Exposure;
 		this->InvGamma		= this->Gamma == 0.0f ? 0.0f : 1.0f / this->Gamma;
 
-		const float AspectRatio = (float)this->Resolution[1] / (float)this->Resolution[0];
+		const float AspectRatio = (float)this->FullResolution[1] / (float)this->FullResolution[0];
 
 		float Scale = tanf((0.5f * FOV / RAD_F));
 
@@ -249,8 +642,15 @@ public:
 			this->Screen[1][1] = Scale;
 		}
 
-		this->InvScreen[0] = (this->Screen[0][1] - this->Screen[0][0]) / (float)this->Resolution[0];
-		this->InvScreen[1] = (this->Screen[1][1] - this->Screen[1][0]) / (float)this->Resolution[1];
+		this->InvScreen[0] = (this->Screen[0][1] - this->Screen[0][0]) / (float)this->FullResolution[0];
+		this->InvScreen[1] = (this->Screen[1][1] - this->Screen[1][0]) / (float)this->FullResolution[1];
+
+		// Narrow the screen window down to the crop, so that film coordinates remain relative to the crop
+		for (int i = 0; i < 2; i++)
+		{
+			this->Screen[i][0] += (float)this->Offset[i] * this->InvScreen[i];
+			this->Screen[i][1] = this->Screen[i][0] + (float)this->Resolution[i] * this->InvScreen[i];
+		}
 	}
 
 	GET_SET_MACRO(HOST_DEVICE, Block, Vec3i)
@@ -259,30 +659,106 @@ public:
 	GET_MACRO(HOST_DEVICE, InvExposure, float)
 	GET_SET_TS_MACRO(HOST_DEVICE, Gamma, float)
 	GET_MACRO(HOST_DEVICE, InvGamma, float)
+	GET_SET_MACRO(HOST_DEVICE, ReprojectionWeight, float)
+	GET_SET_MACRO(HOST_DEVICE, MaxReprojectionWeight, float)
+	GET_MACRO(HOST_DEVICE, ClearAccumulation, bool)
 
 protected:
 	Vec3i							Block;								/*! Cuda thread block size */
 	Vec3i							Grid;								/*! Cuda launch grid size */
 	Vec2i							Resolution;							/*! Resolution of the frame buffer */
+	Vec2i							FullResolution;						/*! Resolution of the entire frame, of which the film may be a crop */
+	Vec2i							Offset;								/*! Position of the film in the entire frame */
 	CudaBuffer2D<ColorXYZAf>		IterationEstimateHDR;				/*! High dynamic range estimate from a single iteration of the mc algorithm */
-	CudaBuffer2D<ColorRGBAuc>		IterationEstimateLDR;				/*! Low dynamic range (tone mapped) estimate from a single iteration of the mc algorithm */
-	CudaBuffer2D<ColorRGBAuc>		IterationEstimateTempFilterLDR;		/*! Low dynamic range (tone mapped) temporary estimate from a single iteration of the mc algorithm (for filtering purposes)*/
-	CudaBuffer2D<ColorRGBAul>		AccumulatedEstimate;				/*! Accumulation buffer */
+	CudaBuffer2D<ColorRGBAf>		AccumulatedEstimate;				/*! Accumulation buffer, with the prior (reprojected) weight in alpha */
 	CudaBuffer2D<ColorRGBuc>		CudaRunningEstimate;				/*! Integrated estimate in cuda memory space*/
 	HostBuffer2D<ColorRGBuc>		HostRunningEstimate;				/*! Integrated estimate in host memory space */
 	CudaRandomSeedBuffer2D			RandomSeeds1;						/*! First random seed buffer */
 	CudaRandomSeedBuffer2D			RandomSeeds2;						/*! Second random seed buffer */
-	HostRandomSeedBuffer2D			HostRandomSeeds1;					/*! First host random seed buffer */
-	HostRandomSeedBuffer2D			HostRandomSeeds2;					/*! Second host random seed buffer */
+	CudaBuffer2D<int>				TileOffsets;						/*! Per tile estimate index at which the tile was last restarted */
+	HostBuffer2D<int>				HostTileOffsets;					/*! Per tile restart offsets in host memory space */
+	bool							TileOffsetsDirty;					/*! Whether the host tile offsets need to be copied to the device */
+	HostBuffer2D<float>				TilePriorities;						/*! Per tile sampling priority */
+	HostBuffer2D<float>				TileCredits;						/*! Per tile accumulated priority, a tile is sampled once it reaches one */
+	CudaBuffer2D<unsigned char>		ActiveTiles;						/*! Per tile flag whether the tile is sampled in the current estimate */
+	HostBuffer2D<unsigned char>		HostActiveTiles;					/*! Active tiles in host memory space */
+	bool							AdaptiveSampling;					/*! Whether tiles are sampled according to their priority */
+	CudaBuffer2D<float>				Depth;								/*! Representative (first scatter) depth per pixel */
+	CudaBuffer2D<float>				ReprojectedDepth;					/*! Depth buffer for resolving visibility during reprojection */
+	CudaBuffer2D<Vec3f>				Normals;							/*! Average gradient direction at the first scatter event */
+	CudaBuffer2D<ColorXYZf>			Albedo;								/*! Average diffuse color at the first scatter event */
+	HostBuffer2D<float>				HostDepth;							/*! Depth in host memory space */
+	HostBuffer2D<Vec3f>				HostNormals;						/*! Normals in host memory space */
+	HostBuffer2D<ColorXYZf>			HostAlbedo;							/*! Albedo in host memory space */
+	CudaBuffer2D<unsigned char>		CudaRunningOpacity;					/*! Opacity of the latest estimate in cuda memory space */
+	HostBuffer2D<unsigned char>		HostRunningOpacity;					/*! Opacity of the latest estimate in host memory space */
+	bool							Features;							/*! Whether the feature buffers are maintained and copied to the host after each estimate */
+	CudaBuffer2D<ColorXYZf>			AccumulatedRadiance;				/*! Sum of the estimates before tone mapping in cuda memory space */
+	HostBuffer2D<ColorXYZf>			HostAccumulatedRadiance;			/*! Sum of the estimates before tone mapping in host memory space */
+	bool							OutputOpacity;						/*! Whether the opacity buffers are maintained and copied to the host after each estimate */
+	bool							OutputRadiance;						/*! Whether the radiance buffers are maintained and copied to the host after each estimate */
+	bool							ClearAccumulation;					/*! Whether the accumulation buffer has to be cleared before the first estimate */
 	float							GaussianFilterWeights[3];			/*! Gaussian filtering weights */
+	float							ToneMapLUT[TONE_MAP_LUT_SIZE + 1];	/*! Tone mapping look up table */
 	int								NoEstimates;						/*! Number of estimates rendererd so far */
 	float							Exposure;							/*! Film exposure */
 	float							InvExposure;						/*! Reciprocal of the exposure */
 	float							Gamma;								/*! Monitor gamma */
 	float							InvGamma;							/*! Reciprocal of the monitor gamma */
+	float							ReprojectionWeight;					/*! Factor with which reprojected estimates are down-weighted */
+	float							MaxReprojectionWeight;				/*! Maximum number of virtual estimates a reprojected pixel carries */
 	float							Screen[2][2];						/*! Pre-computed values for sampling the film plane efficiently */
 	float							InvScreen[2];						/*! Pre-computed values for sampling the film plane efficiently */
 
+private:
+	/*! Allocates the feature buffers at the film resolution while they are enabled, and frees them otherwise */
+	HOST void ResizeFeatureBuffers()
+	{
+		const Vec2i Resolution = this->Features ? this->Resolution : Vec2i(0, 0);
+
+		this->Normals.Resize(Resolution);
+		this->Albedo.Resize(Resolution);
+		this->HostDepth.Resize(Resolution);
+		this->HostNormals.Resize(Resolution);
+		this->HostAlbedo.Resize(Resolution);
+	}
+
+	/*! Allocates the adaptive sampling buffers at the tile resolution while adaptive sampling is enabled, and frees them otherwise. All tiles start at full priority */
+	HOST void ResizeAdaptiveBuffers()
+	{
+		const Vec2i NoTiles = this->AdaptiveSampling ? this->HostTileOffsets.GetResolution() : Vec2i(0, 0);
+
+		if (this->TilePriorities.GetResolution() != NoTiles)
+		{
+			this->TilePriorities.Resize(NoTiles);
+
+			for (int i = 0; i < this->TilePriorities.GetNoElements(); i++)
+				this->TilePriorities[i] = 1.0f;
+		}
+
+		this->TileCredits.Resize(NoTiles);
+		this->ActiveTiles.Resize(NoTiles);
+		this->HostActiveTiles.Resize(NoTiles);
+	}
+
+	/*! Allocates the opacity buffers at the film resolution while opacity output is enabled, and frees them otherwise */
+	HOST void ResizeOpacityBuffers()
+	{
+		const Vec2i Resolution = this->OutputOpacity ? this->Resolution : Vec2i(0, 0);
+
+		this->CudaRunningOpacity.Resize(Resolution);
+		this->HostRunningOpacity.Resize(Resolution);
+	}
+
+	/*! Allocates the radiance buffers at the film resolution while radiance output is enabled, and frees them otherwise */
+	HOST void ResizeRadianceBuffers()
+	{
+		const Vec2i Resolution = this->OutputRadiance ? this->Resolution : Vec2i(0, 0);
+
+		this->AccumulatedRadiance.Resize(Resolution);
+		this->HostAccumulatedRadiance.Resize(Resolution);
+	}
+
 friend class Camera;
 };
 
@@ -1,12 +0,0 @@
-#pragma once
-
-#include "core\kernel.cuh"
-
-namespace ExposureRender
-{
-
-class Renderer;
-
-extern "C" void Filter(Renderer* HostRenderer, Renderer* DevRenderer);
-
-}
\ No newline at end of file
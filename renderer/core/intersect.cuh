@@ -33,9 +33,18 @@ namespace ExposureRender
 DEVICE bool IntersectVolume(Volume& V, Ray R, RNG& RNG, ScatterEvent& SE)
 {
 	if (!V.GetBoundingBox().Intersect(R, R.MinT, R.MaxT))
+	{
 		return false;
+	}
 	else
+	{
+		SE.SetP(R(R.MinT));
+		SE.SetWo(-R.D);
+		SE.SetT(R.MinT);
+		SE.SetScatterType(Enums::Volume);
+
 		return true;
+	}
 
 	Tracer& T = V.GetTracer();
 
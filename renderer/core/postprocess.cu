@@ -0,0 +1,151 @@
+
+#include "postprocess.cuh"
+#include "core\cudawrapper.h"
+#include "core\renderer.h"
+
+namespace ExposureRender
+{
+
+/*! Tone maps, filters, accumulates and integrates the iteration estimate in a single pass
+	Each thread block tone maps its tile plus a one pixel apron into shared memory, so the hdr estimate is read once and no intermediate ldr buffers are written
+	@param[in] Renderer Renderer
+	@param[in] Filter Whether to apply the 3 x 3 gaussian filter to the tone mapped estimate
+*/
+KERNEL void KrnlPostProcess(Renderer* Renderer, bool Filter)
+{
+	extern __shared__ uchar4 Tile[];
+
+	Film& Film = Renderer->Camera.GetFilm();
+
+	const int TileWidth		= blockDim.x + 2;
+	const int TileHeight	= blockDim.y + 2;
+	const int TileOrigin[2]	= { blockIdx.x * blockDim.x - 1, blockIdx.y * blockDim.y - 1 };
+
+	CudaBuffer2D<ColorXYZAf>& IterationEstimateHDR = Film.GetIterationEstimateHDR();
+
+	for (int i = threadIdx.y * blockDim.x + threadIdx.x; i < TileWidth * TileHeight; i += blockDim.x * blockDim.y)
+	{
+		const int TX = TileOrigin[0] + i % TileWidth;
+		const int TY = TileOrigin[1] + i / TileWidth;
+
+		if (TX < 0 || TY < 0 || TX >= Film.GetWidth() || TY >= Film.GetHeight())
+			continue;
+
+		ColorXYZAf EstimateXYZA = IterationEstimateHDR(TX, TY);
+
+		EstimateXYZA.ToneMap(0.1f, Film.GetToneMapLUT());
+
+		const ColorRGBAuc EstimateRGBA = ColorRGBAuc::FromXYZAf(EstimateXYZA.D);
+
+		Tile[i] = make_uchar4(EstimateRGBA[0], EstimateRGBA[1], EstimateRGBA[2], EstimateRGBA[3]);
+	}
+
+	__syncthreads();
+
+	const int X 	= blockIdx.x * blockDim.x + threadIdx.x;
+	const int Y		= blockIdx.y * blockDim.y + threadIdx.y;
+
+	if (X >= Film.GetWidth() || Y >= Film.GetHeight())
+		return;
+
+	// Tiles skipped by adaptive sampling keep their accumulation and running estimate as is
+	if (!Film.IsTileActive(X, Y))
+		return;
+
+	const int TileX = threadIdx.x + 1;
+	const int TileY = threadIdx.y + 1;
+
+	float Estimate[4];
+
+	if (Filter)
+	{
+		// The separable gaussian is applied as a single 3 x 3 kernel, normalized over the taps that lie on the film
+		const int Range[2][2] =
+		{
+			{ Max(X - 1, 0) - X, Min(X + 1, Film.GetWidth() - 1) - X },
+			{ Max(Y - 1, 0) - Y, Min(Y + 1, Film.GetHeight() - 1) - Y }
+		};
+
+		const float* Weights = Film.GetGaussianFilterWeights();
+
+		float Sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float SumWeight = 0.0f;
+
+		for (int y = Range[1][0]; y <= Range[1][1]; y++)
+		{
+			for (int x = Range[0][0]; x <= Range[0][1]; x++)
+			{
+				const float Weight = Weights[x + 1] * Weights[y + 1];
+
+				const uchar4 Color = Tile[(TileY + y) * TileWidth + TileX + x];
+
+				Sum[0]		+= Weight * Color.x;
+				Sum[1]		+= Weight * Color.y;
+				Sum[2]		+= Weight * Color.z;
+				Sum[3]		+= Weight * Color.w;
+				SumWeight	+= Weight;
+			}
+		}
+
+		for (int c = 0; c < 4; c++)
+			Estimate[c] = (float)(unsigned char)(Sum[c] / SumWeight);
+	}
+	else
+	{
+		const uchar4 Color = Tile[TileY * TileWidth + TileX];
+
+		Estimate[0] = Color.x;
+		Estimate[1] = Color.y;
+		Estimate[2] = Color.z;
+		Estimate[3] = Color.w;
+	}
+
+	CudaBuffer2D<ColorRGBAf>& AccumulatedEstimate	= Film.GetAccumulatedEstimate();
+	CudaBuffer2D<ColorRGBuc>& CudaRunningEstimate	= Film.GetCudaRunningEstimate();
+
+	ColorRGBAf Accumulated = AccumulatedEstimate(X, Y);
+
+	// Full restarts clear (or seed with a reprojected estimate) the accumulation buffer up front, tiles restarted on their own start from scratch here
+	if (Film.GetNoEstimates(X, Y) == 1 && Film.GetNoEstimates() > 1)
+		Accumulated = ColorRGBAf();
+
+	for (int c = 0; c < 3; c++)
+		Accumulated[c] += Estimate[c];
+
+	AccumulatedEstimate.Set(X, Y, Accumulated);
+
+	const float NoEstimates = (float)Film.GetNoEstimates(X, Y) + Accumulated[3];
+
+	for (int c = 0; c < 3; c++)
+		CudaRunningEstimate(X, Y)[c] = (unsigned char)((float)Accumulated[c] / NoEstimates);
+
+	// The radiance sums are restarted along with the pixel, reprojected priors only seed the tone mapped accumulation
+	if (Film.GetOutputRadiance())
+	{
+		const ColorXYZAf HDR = IterationEstimateHDR(X, Y);
+
+		ColorXYZf Radiance = Film.GetNoEstimates(X, Y) == 1 ? ColorXYZf() : Film.GetAccumulatedRadiance()(X, Y);
+
+		for (int c = 0; c < 3; c++)
+			Radiance[c] += HDR[c];
+
+		Film.GetAccumulatedRadiance().Set(X, Y, Radiance);
+	}
+
+	// Opacity is only output for (deterministic) standard ray casting, so the latest estimate is the converged one
+	if (Film.GetOutputOpacity())
+		Film.GetCudaRunningOpacity()(X, Y) = (unsigned char)Estimate[3];
+}
+
+void PostProcess(Renderer* HostRenderer, Renderer* DevRenderer, const bool& Filter)
+{
+	LAUNCH_DIMENSIONS
+
+	const int TileSize = (Block.x + 2) * (Block.y + 2) * sizeof(uchar4);
+
+	KrnlPostProcess<<<Grid, Block, TileSize>>>(DevRenderer, Filter);
+	cudaThreadSynchronize();
+	Cuda::HandleCudaError(cudaGetLastError(), "Post process");
+}
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "core\kernel.cuh"
+
+namespace ExposureRender
+{
+
+class Renderer;
+
+extern "C" void PostProcess(Renderer* HostRenderer, Renderer* DevRenderer, const bool& Filter);
+
+}
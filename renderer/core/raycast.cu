@@ -0,0 +1,89 @@
+
+#include "raycast.cuh"
+#include "core\cudawrapper.h"
+#include "core\renderer.h"
+
+namespace ExposureRender
+{
+
+/*! Integrates emission and absorption front-to-back along ray \a R through volume \a V, terminating early once the accumulated opacity reaches the tracer's opacity threshold
+	@param[in] V Input volume
+	@param[in] R Ray in world space
+	@return Pre-multiplied color and accumulated opacity
+*/
+DEVICE ColorXYZAf IntegrateVolume(Volume& V, Ray R)
+{
+	ColorXYZAf Result;
+
+	float FullMinT = 0.0f, FullMaxT = 0.0f;
+
+	if (!V.GetFullBoundingBox().Intersect(R, FullMinT, FullMaxT))
+		return Result;
+
+	if (!V.GetBoundingBox().Intersect(R, R.MinT, R.MaxT))
+		return Result;
+
+	Tracer& T = V.GetTracer();
+
+	const float StepSize	= T.GetStepFactorPrimary();
+	const float Threshold	= T.GetOpacityThreshold();
+
+	// Keep the sample positions on the grid of the entire volume, so bricks rendered by different nodes composite seamlessly
+	const float FirstT = FullMinT + (ceilf((R.MinT - FullMinT) / StepSize - 0.5f) + 0.5f) * StepSize;
+
+	ColorXYZf Color;
+	float Alpha = 0.0f;
+
+	for (float t = FirstT; t < R.MaxT; t += StepSize)
+	{
+		const short Intensity = V.GetIntensity(R(t));
+
+		const float Opacity = T.GetOpacity(Intensity);
+
+		if (Opacity <= 0.0f)
+			continue;
+
+		const float SampleAlpha = 1.0f - expf(-T.GetDensityScale() * Opacity * StepSize);
+
+		const ColorXYZf SampleColor = T.GetDiffuse(Intensity) + T.GetEmission(Intensity);
+
+		Color = Color + ((1.0f - Alpha) * SampleAlpha) * SampleColor;
+		Alpha = Alpha + (1.0f - Alpha) * SampleAlpha;
+
+		if (Alpha >= Threshold)
+			break;
+	}
+
+	Result[0] = Color[0];
+	Result[1] = Color[1];
+	Result[2] = Color[2];
+	Result[3] = Alpha;
+
+	return Result;
+}
+
+KERNEL void KrnlRayCast(Renderer* Renderer)
+{
+	const int X 	= blockIdx.x * blockDim.x + threadIdx.x;
+	const int Y		= blockIdx.y * blockDim.y + threadIdx.y;
+
+	if (X >= Renderer->Camera.GetFilm().GetWidth() || Y >= Renderer->Camera.GetFilm().GetHeight())
+		return;
+	
+	Ray R;
+
+	Renderer->Camera.SampleCenter(R, Vec2i(X, Y));
+
+	Renderer->Camera.GetFilm().GetIterationEstimateHDR().Set(X, Y, IntegrateVolume(Renderer->Volume, R));
+}
+
+void RayCast(Renderer* HostRenderer, Renderer* DevRenderer)
+{
+	LAUNCH_DIMENSIONS
+
+	KrnlRayCast<<<Grid, Block>>>(DevRenderer);
+	cudaThreadSynchronize();
+	Cuda::HandleCudaError(cudaGetLastError(), "Ray cast");
+}
+
+}
@@ -7,6 +7,6 @@ namespace ExposureRender
 
 class Renderer;
 
-extern "C" void ToneMap(Renderer* HostRenderer, Renderer* DevRenderer);
+extern "C" void RayCast(Renderer* HostRenderer, Renderer* DevRenderer);
 
 }
\ No newline at end of file
@@ -1,10 +1,8 @@
 
 #include "render.cuh"
 #include "core\estimate.cuh"
-#include "core\tonemap.cuh"
-#include "core\filter.cuh"
-#include "core\integrate.cuh"
-#include "core\accumulate.cuh"
+#include "core\raycast.cuh"
+#include "core\postprocess.cuh"
 #include "core\camera.h"
 #include "core\renderer.h"
 
@@ -15,30 +13,39 @@ void Render(Renderer* HostRenderer)
 {
 	Film& Film = HostRenderer->Camera.GetFilm();
 
-	if (Film.GetNoEstimates() == 1)
-	{
+	// Standard ray casting is deterministic, so every frame is a converged estimate on its own
+	const bool StandardRayCasting = HostRenderer->Volume.GetTracer().GetRenderMode() == Enums::StandardRayCasting;
+
+	if (StandardRayCasting)
+		Film.Restart();
+
+	if (Film.GetNoEstimates() == 1 && Film.GetClearAccumulation())
 		Film.GetAccumulatedEstimate().Reset();
 
-		Film.GetRandomSeeds1().FromHost(Film.GetHostRandomSeeds1().GetData());
-		Film.GetRandomSeeds2().FromHost(Film.GetHostRandomSeeds2().GetData());
-	}
+	Film.SelectActiveTiles();
+	Film.UploadTileOffsets();
 
 	Renderer* DevRenderer = 0;
 
 	Cuda::HandleCudaError(cudaMalloc((void**)&DevRenderer, sizeof(Renderer)));
 	Cuda::HandleCudaError(cudaMemcpy(DevRenderer, HostRenderer, sizeof(Renderer), cudaMemcpyHostToDevice));
 
-	Estimate(HostRenderer, DevRenderer);
-	ToneMap(HostRenderer, DevRenderer);
-	Filter(HostRenderer, DevRenderer);
-	Accumulate(HostRenderer, DevRenderer);
-	Integrate(HostRenderer, DevRenderer);
+	if (StandardRayCasting)
+		RayCast(HostRenderer, DevRenderer);
+	else
+		Estimate(HostRenderer, DevRenderer);
+
+	PostProcess(HostRenderer, DevRenderer, !StandardRayCasting);
 
 	Cuda::HandleCudaError(cudaFree(DevRenderer));
 
 	Film.IncrementNoEstimates();
 
 	Cuda::HandleCudaError(cudaMemcpy(Film.GetHostRunningEstimate().GetData(), Film.GetCudaRunningEstimate().GetData(), Film.GetCudaRunningEstimate().GetNoBytes(), cudaMemcpyDeviceToHost));
+
+	Film.DownloadFeatureBuffers();
+	Film.DownloadOpacityBuffer();
+	Film.DownloadRadianceBuffer();
 }
 
 }
@@ -1,6 +1,7 @@
 
 #include "core\renderthread.h"
 #include "core\render.cuh"
+#include "core\reproject.cuh"
 
 #include <QSettings>
 #include <QBuffer>
@@ -11,12 +12,25 @@
 
 #include <time.h>
 
+#include <cuda_runtime_api.h>
+
 QRenderer::QRenderer(QObject* Parent /*= 0*/) :
 	QObject(Parent),
 	Settings("renderer.ini", QSettings::IniFormat),
 	RenderTimer(),
 	AvgFps(),
-	Renderer()
+	RenderTime(),
+	SamplesPerSecond(),
+	DeviceName("Unknown device"),
+	Reprojection(true),
+	Denoiser(),
+	Renderer(),
+	CameraPending(false),
+	CameraPos(0.0f),
+	CameraTarget(0.0f),
+	CameraUp(0.0f),
+	ViewEpoch(0),
+	RenderedEpoch(0)
 {
 	connect(&this->RenderTimer, SIGNAL(timeout()), this, SLOT(OnRender()));
 
@@ -27,19 +41,199 @@ QRenderer::QRenderer(QObject* Parent /*= 0*/) :
 
 	this->Renderer.Volume.GetTracer().SetStepFactorPrimary(Settings.value("traversal/stepfactorprimary", 3.0).toFloat());
 	this->Renderer.Volume.GetTracer().SetStepFactorOcclusion(Settings.value("traversal/stepfactorocclusion", 6.0).toFloat());
+	this->Renderer.Volume.GetTracer().SetOpacityThreshold(Settings.value("traversal/opacitythreshold", 0.99).toFloat());
+	this->Reprojection = Settings.value("rendering/reprojection", true).toBool();
+
+	this->Renderer.Camera.GetFilm().SetReprojectionWeight(Settings.value("rendering/reprojectionweight", 0.5).toFloat());
+	this->Renderer.Camera.GetFilm().SetMaxReprojectionWeight(Settings.value("rendering/maxreprojectionweight", 16.0).toFloat());
+
+	this->Denoiser.Enabled			= Settings.value("denoising/enabled", false).toBool();
+	this->Denoiser.NoIterations		= Settings.value("denoising/iterations", 5).toInt();
+	this->Denoiser.SigmaColor		= Settings.value("denoising/sigmacolor", 0.5).toFloat();
+	this->Denoiser.SigmaNormal		= Settings.value("denoising/sigmanormal", 0.1).toFloat();
+	this->Denoiser.SigmaDepth		= Settings.value("denoising/sigmadepth", 0.05).toFloat();
+	this->Denoiser.SigmaAlbedo		= Settings.value("denoising/sigmaalbedo", 0.1).toFloat();
+	this->Denoiser.MaxNoEstimates	= Settings.value("denoising/maxestimates", 64).toInt();
+
+	this->Renderer.Camera.GetFilm().SetFeatures(this->Denoiser.Enabled);
+
+	int DeviceID = 0;
+	cudaDeviceProp DeviceProperties;
+
+	if (cudaGetDevice(&DeviceID) == cudaSuccess && cudaGetDeviceProperties(&DeviceProperties, DeviceID) == cudaSuccess)
+		this->DeviceName = DeviceProperties.name;
+
+	this->PrintMemoryReport();
+
+	this->Renderer.Volume.GetTracer().SetRenderMode(this->GetConfiguredRenderMode());
 	
 	this->Renderer.Volume.GetTracer().GetOpacity1D().AddNode(0.0f, 1.0f);
 	this->Renderer.Volume.GetTracer().GetOpacity1D().AddNode(10, 1.0f);
 	this->Renderer.Volume.GetTracer().GetOpacity1D().AddNode(60000.0f, 0.0f);
 }
 
+void QRenderer::PrintMemoryReport()
+{
+	Film& Film = this->Renderer.Camera.GetFilm();
+
+	const Vec2i Resolutions[] = { Film.GetResolution(), Vec2i(1280, 720), Vec2i(1920, 1080), Vec2i(3840, 2160) };
+
+	for (int i = 0; i < 4; i++)
+	{
+		long long DeviceBytes = 0, HostBytes = 0;
+
+		Film::GetMemorySize(Resolutions[i], Film.GetFeatures(), Film.GetOutputOpacity(), Film.GetOutputRadiance(), DeviceBytes, HostBytes);
+
+		qDebug() << QString("Film %1 x %2: %3 MB device, %4 MB host").arg(Resolutions[i][0]).arg(Resolutions[i][1]).arg((double)DeviceBytes / 1048576.0, 0, 'f', 1).arg((double)HostBytes / 1048576.0, 0, 'f', 1);
+	}
+}
+
 void QRenderer::Start()
 {
 	this->RenderTimer.start(Settings.value("rendering/targetfps", 60).toInt());
 }
 
+void QRenderer::Stop()
+{
+	this->RenderTimer.stop();
+}
+
+void QRenderer::RestartRegion(const BoundingBox& OldBounds, const BoundingBox& NewBounds)
+{
+	Camera& Camera = this->Renderer.Camera;
+
+	Camera.Update();
+
+	Vec2i Min, Max;
+
+	if (Camera.ProjectBoundingBoxToFilmPlane(OldBounds, Min, Max))
+		Camera.GetFilm().RestartRegion(Min, Max);
+
+	if (Camera.ProjectBoundingBoxToFilmPlane(NewBounds, Min, Max))
+		Camera.GetFilm().RestartRegion(Min, Max);
+}
+
+void QRenderer::SetCamera(const Vec3f& Pos, const Vec3f& Target, const Vec3f& Up, const quint32& Epoch)
+{
+	// Only the latest camera before the next frame is applied, cameras that arrive in a burst restart the film once
+	this->CameraPending	= true;
+	this->CameraPos		= Pos;
+	this->CameraTarget	= Target;
+	this->CameraUp		= Up;
+	this->ViewEpoch		= Epoch;
+}
+
+void QRenderer::ApplyCamera()
+{
+	this->CameraPending = false;
+
+	Camera& Camera = this->Renderer.Camera;
+
+	Camera.Update();
+
+	const CameraView PreviousView = Camera.GetView();
+
+	Camera.SetPos(this->CameraPos);
+	Camera.SetTarget(this->CameraTarget);
+	Camera.SetUp(this->CameraUp);
+
+	Camera.Update();
+
+	const bool Reproject = this->Reprojection && this->Renderer.Volume.GetTracer().GetRenderMode() == Enums::StochasticRayCasting && Camera.GetFilm().GetNoEstimates() > 1;
+
+	if (Reproject)
+		ExposureRender::Reproject(&this->Renderer, PreviousView);
+	else
+		Camera.GetFilm().Restart();
+}
+
+void QRenderer::SetCrop(const Vec2i& FullResolution, const Vec2i& Offset, const Vec2i& Resolution)
+{
+	qDebug() << "Rendering crop" << Offset[0] << Offset[1] << Resolution[0] << "x" << Resolution[1] << "of" << FullResolution[0] << "x" << FullResolution[1];
+
+	this->Renderer.Camera.GetFilm().SetCrop(FullResolution, Offset, Resolution);
+}
+
+void QRenderer::SetPriorityMap(const int& MapTileSize, const HostBuffer2D<unsigned char>& Map)
+{
+	Film& Film = this->Renderer.Camera.GetFilm();
+
+	HostBuffer2D<float> Priorities;
+
+	// The map covers the entire frame, each film tile takes the priority at its center
+	if (MapTileSize > 0 && !Map.IsEmpty())
+	{
+		Priorities.Resize(Film.GetHostTileOffsets().GetResolution());
+
+		for (int TileY = 0; TileY < Priorities.Height(); TileY++)
+		{
+			for (int TileX = 0; TileX < Priorities.Width(); TileX++)
+			{
+				const int X = Film.GetOffset()[0] + qMin(TileX * FILM_TILE_SIZE + FILM_TILE_SIZE / 2, Film.GetWidth() - 1);
+				const int Y = Film.GetOffset()[1] + qMin(TileY * FILM_TILE_SIZE + FILM_TILE_SIZE / 2, Film.GetHeight() - 1);
+
+				Priorities(TileX, TileY) = (float)Map(qMin(X / MapTileSize, Map.Width() - 1), qMin(Y / MapTileSize, Map.Height() - 1)) / 255.0f;
+			}
+		}
+	}
+
+	Film.SetTilePriorities(Priorities);
+}
+
+Enums::RenderMode QRenderer::GetConfiguredRenderMode()
+{
+	return this->Settings.value("rendering/mode", "stochastic").toString() == "standard" ? Enums::StandardRayCasting : Enums::StochasticRayCasting;
+}
+
+void QRenderer::SetVolume(const Vec3i& Resolution, const Vec3f& Spacing, short* Voxels)
+{
+	this->Renderer.Volume.Create(Resolution, Spacing, Voxels);
+
+	// A full volume undoes a previous brick, it is rendered in the configured mode and without the opacity sort-last compositing needed
+	this->Renderer.Volume.GetTracer().SetRenderMode(this->GetConfiguredRenderMode());
+
+	this->Renderer.Camera.GetFilm().SetOutputOpacity(false);
+	this->Renderer.Camera.GetFilm().Restart();
+}
+
+void QRenderer::SetBrick(const Vec3i& Resolution, const Vec3f& Spacing, short* Voxels, const Vec3i& FullResolution, const Vec3i& Offset, const Vec3i& CoreMin, const Vec3i& CoreMax)
+{
+	qDebug() << "Rendering brick" << CoreMin[0] << CoreMin[1] << CoreMin[2] << "-" << CoreMax[0] << CoreMax[1] << CoreMax[2] << "of" << FullResolution[0] << "x" << FullResolution[1] << "x" << FullResolution[2];
+
+	Volume& Volume = this->Renderer.Volume;
+
+	Film& Film = this->Renderer.Camera.GetFilm();
+
+	// A rebalance only moves the slab boundaries of the same volume, outside the old and the new slab the image is empty either way
+	const BoundingBox OldCore	= Volume.GetBoundingBox();
+	const BoundingBox OldFull	= Volume.GetFullBoundingBox();
+	const bool WasBrick			= Film.GetOutputOpacity() && Volume.GetTracer().GetRenderMode() == Enums::StandardRayCasting;
+
+	Volume.Create(Resolution, Spacing, Voxels);
+
+	const Vec3f Origin(Offset[0] * Spacing[0], Offset[1] * Spacing[1], Offset[2] * Spacing[2]);
+
+	const BoundingBox Core(Vec3f(CoreMin[0] * Spacing[0], CoreMin[1] * Spacing[1], CoreMin[2] * Spacing[2]), Vec3f(CoreMax[0] * Spacing[0], CoreMax[1] * Spacing[1], CoreMax[2] * Spacing[2]));
+	const BoundingBox Full(Vec3f(0.0f), Vec3f(FullResolution[0] * Spacing[0], FullResolution[1] * Spacing[1], FullResolution[2] * Spacing[2]));
+
+	Volume.SetBrick(Origin, Core, Full);
+
+	// Sort-last compositing needs premultiplied color and opacity per pixel, which only the emission-absorption ray caster produces
+	Volume.GetTracer().SetRenderMode(Enums::StandardRayCasting);
+
+	Film.SetOutputOpacity(true);
+
+	if (WasBrick && OldFull.GetMinP() == Full.GetMinP() && OldFull.GetMaxP() == Full.GetMaxP())
+		this->RestartRegion(OldCore, Core);
+	else
+		Film.Restart();
+}
+
 void QRenderer::OnRender()
 {
+	if (this->CameraPending)
+		this->ApplyCamera();
+
 	this->Renderer.Camera.SetApertureSize(0.0f);
 	this->Renderer.Camera.SetFocalDistance(0.5f);
 
@@ -49,7 +243,21 @@ void QRenderer::OnRender()
 	
 	ExposureRender::Render(&this->Renderer);
 
+	// Standard ray casting is noise free
+	if (this->Renderer.Volume.GetTracer().GetRenderMode() == Enums::StochasticRayCasting)
+		this->Denoiser.Denoise(this->Renderer.Camera.GetFilm());
+
 	const clock_t End = clock();
 
 	AvgFps.PushValue(1000.0f / (End - Begin));
+
+	const float Time = 1000.0f * (float)(End - Begin) / (float)CLOCKS_PER_SEC;
+
+	this->RenderTime.PushValue(Time);
+
+	// The compositor apportions work by this capacity, so it counts the samples actually taken rather than the film size
+	if (Time > 0.0f)
+		this->SamplesPerSecond.PushValue(1000.0f * (float)this->Renderer.Camera.GetFilm().GetNoSampledPixels() / Time);
+
+	this->RenderedEpoch = this->ViewEpoch;
 }
\ No newline at end of file
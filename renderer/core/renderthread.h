@@ -8,6 +8,7 @@
 #include "buffer\buffers.h"
 #include "color\color.h"
 #include "core\renderer.h"
+#include "filtering\denoiser.h"
 
 using namespace ExposureRender;
 
@@ -20,13 +21,36 @@ public:
 	virtual ~QRenderer() {};
 
 	void Start();
+	void Stop();
+	void PrintMemoryReport();
+	void RestartRegion(const BoundingBox& OldBounds, const BoundingBox& NewBounds);
+	void SetCamera(const Vec3f& Pos, const Vec3f& Target, const Vec3f& Up, const quint32& Epoch);
+	void SetCrop(const Vec2i& FullResolution, const Vec2i& Offset, const Vec2i& Resolution);
+	void SetPriorityMap(const int& MapTileSize, const HostBuffer2D<unsigned char>& Map);
+	void SetVolume(const Vec3i& Resolution, const Vec3f& Spacing, short* Voxels);
+	void SetBrick(const Vec3i& Resolution, const Vec3f& Spacing, short* Voxels, const Vec3i& FullResolution, const Vec3i& Offset, const Vec3i& CoreMin, const Vec3i& CoreMax);
 
 public slots:
 	void OnRender();
 
+private:
+	void ApplyCamera();
+	Enums::RenderMode GetConfiguredRenderMode();
+
 public:
 	QSettings 					Settings;
 	QTimer						RenderTimer;
 	QHysteresis					AvgFps;
+	QHysteresis					RenderTime;
+	QHysteresis					SamplesPerSecond;
+	QString						DeviceName;
+	bool						Reprojection;
+	QDenoiser					Denoiser;
 	ExposureRender::Renderer	Renderer;
+	bool						CameraPending;
+	Vec3f						CameraPos;
+	Vec3f						CameraTarget;
+	Vec3f						CameraUp;
+	quint32						ViewEpoch;
+	quint32						RenderedEpoch;
 };
\ No newline at end of file
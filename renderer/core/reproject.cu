@@ -0,0 +1,153 @@
+
+#include "reproject.cuh"
+#include "core\cudawrapper.h"
+#include "core\renderer.h"
+
+namespace ExposureRender
+{
+
+// The iteration estimate is only alive while an estimate is rendered, so reprojection borrows it to scatter the average color (rgb) and weight (alpha) into the current view
+
+/*! Reconstructs the world space point seen by pixel \a X, \a Y in \a PreviousView and projects it into the current camera
+	@param[in] Renderer Renderer, holding the current camera
+	@param[in] PreviousView View in which the estimate was accumulated
+	@param[in] X X position on the film plane
+	@param[in] Y Y position on the film plane
+	@param[out] Target Pixel in the current view
+	@param[out] TargetDepth Distance to the point from the current camera position
+	@return Whether the point lands on the film in the current view
+*/
+DEVICE bool ReprojectPixel(Renderer* Renderer, const CameraView& PreviousView, const int& X, const int& Y, Vec2i& Target, float& TargetDepth)
+{
+	Film& Film = Renderer->Camera.GetFilm();
+
+	const float Depth = Film.GetDepth()(X, Y);
+
+	if (Depth <= 0.0f)
+		return false;
+
+	const Vec3f P = PreviousView.Pos + PreviousView.GetDirection(Vec2f(X + 0.5f, Y + 0.5f)) * Depth;
+
+	Vec2f FilmUV;
+
+	if (!Renderer->Camera.ProjectPointToFilmPlane(P, FilmUV))
+		return false;
+
+	Target[0] = Min((int)floorf(FilmUV[0]), Film.GetWidth() - 1);
+	Target[1] = Min((int)floorf(FilmUV[1]), Film.GetHeight() - 1);
+
+	TargetDepth = Length(P, Renderer->Camera.GetPos());
+
+	return true;
+}
+
+KERNEL void KrnlReprojectClear(Renderer* Renderer)
+{
+	const int X 	= blockIdx.x * blockDim.x + threadIdx.x;
+	const int Y		= blockIdx.y * blockDim.y + threadIdx.y;
+
+	Film& Film = Renderer->Camera.GetFilm();
+
+	if (X >= Film.GetWidth() || Y >= Film.GetHeight())
+		return;
+
+	Film.GetIterationEstimateHDR().Set(X, Y, ColorXYZAf(0.0f, 0.0f, 0.0f, 0.0f));
+	Film.GetReprojectedDepth().Set(X, Y, FLT_MAX);
+}
+
+KERNEL void KrnlReprojectDepth(Renderer* Renderer, CameraView PreviousView)
+{
+	const int X 	= blockIdx.x * blockDim.x + threadIdx.x;
+	const int Y		= blockIdx.y * blockDim.y + threadIdx.y;
+
+	Film& Film = Renderer->Camera.GetFilm();
+
+	if (X >= Film.GetWidth() || Y >= Film.GetHeight())
+		return;
+
+	Vec2i Target;
+	float TargetDepth = 0.0f;
+
+	if (!ReprojectPixel(Renderer, PreviousView, X, Y, Target, TargetDepth))
+		return;
+
+	// Positive floats order the same as their integer bit patterns, so the nearest surface wins
+	atomicMin((int*)&Film.GetReprojectedDepth()(Target[0], Target[1]), __float_as_int(TargetDepth));
+}
+
+KERNEL void KrnlReprojectEstimate(Renderer* Renderer, CameraView PreviousView)
+{
+	const int X 	= blockIdx.x * blockDim.x + threadIdx.x;
+	const int Y		= blockIdx.y * blockDim.y + threadIdx.y;
+
+	Film& Film = Renderer->Camera.GetFilm();
+
+	if (X >= Film.GetWidth() || Y >= Film.GetHeight())
+		return;
+
+	Vec2i Target;
+	float TargetDepth = 0.0f;
+
+	if (!ReprojectPixel(Renderer, PreviousView, X, Y, Target, TargetDepth))
+		return;
+
+	if (__float_as_int(TargetDepth) != __float_as_int(Film.GetReprojectedDepth()(Target[0], Target[1])))
+		return;
+
+	// The film has already advanced past the last estimate, hence the minus one
+	const ColorRGBAf& Accumulated = Film.GetAccumulatedEstimate()(X, Y);
+
+	const float NoEstimates = (float)(Film.GetNoEstimates(X, Y) - 1) + Accumulated[3];
+
+	if (NoEstimates <= 0.0f)
+		return;
+
+	const float Weight = Film.GetReprojectionWeight() * Min(NoEstimates, Film.GetMaxReprojectionWeight());
+
+	Film.GetIterationEstimateHDR().Set(Target[0], Target[1], ColorXYZAf(Accumulated[0] / NoEstimates, Accumulated[1] / NoEstimates, Accumulated[2] / NoEstimates, Weight));
+}
+
+KERNEL void KrnlReprojectResolve(Renderer* Renderer)
+{
+	const int X 	= blockIdx.x * blockDim.x + threadIdx.x;
+	const int Y		= blockIdx.y * blockDim.y + threadIdx.y;
+
+	Film& Film = Renderer->Camera.GetFilm();
+
+	if (X >= Film.GetWidth() || Y >= Film.GetHeight())
+		return;
+
+	const float ReprojectedDepth = Film.GetReprojectedDepth()(X, Y);
+
+	Film.GetDepth().Set(X, Y, ReprojectedDepth < FLT_MAX ? ReprojectedDepth : 0.0f);
+
+	// Seed the accumulation buffer, the weight becomes the number of virtual estimates the pixel starts with
+	const ColorXYZAf& Reprojected = Film.GetIterationEstimateHDR()(X, Y);
+
+	const float Weight = Reprojected[3];
+
+	Film.GetAccumulatedEstimate().Set(X, Y, ColorRGBAf(Weight * Reprojected[0], Weight * Reprojected[1], Weight * Reprojected[2], Weight));
+}
+
+void Reproject(Renderer* HostRenderer, const CameraView& PreviousView)
+{
+	LAUNCH_DIMENSIONS
+
+	Renderer* DevRenderer = 0;
+
+	Cuda::HandleCudaError(cudaMalloc((void**)&DevRenderer, sizeof(Renderer)));
+	Cuda::HandleCudaError(cudaMemcpy(DevRenderer, HostRenderer, sizeof(Renderer), cudaMemcpyHostToDevice));
+
+	KrnlReprojectClear<<<Grid, Block>>>(DevRenderer);
+	KrnlReprojectDepth<<<Grid, Block>>>(DevRenderer, PreviousView);
+	KrnlReprojectEstimate<<<Grid, Block>>>(DevRenderer, PreviousView);
+	KrnlReprojectResolve<<<Grid, Block>>>(DevRenderer);
+	cudaThreadSynchronize();
+	Cuda::HandleCudaError(cudaGetLastError(), "Reproject");
+
+	Cuda::HandleCudaError(cudaFree(DevRenderer));
+
+	HostRenderer->Camera.GetFilm().Restart(true);
+}
+
+}
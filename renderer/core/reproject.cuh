@@ -0,0 +1,13 @@
+#pragma once
+
+#include "core\kernel.cuh"
+
+namespace ExposureRender
+{
+
+class Renderer;
+class CameraView;
+
+extern "C" void Reproject(Renderer* HostRenderer, const CameraView& PreviousView);
+
+}
\ No newline at end of file
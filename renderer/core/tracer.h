@@ -43,7 +43,9 @@ public:
 		GradientMode(Enums::CentralDifferences),
 		AcceleratorType(Enums::Octree),
 		StepFactorPrimary(1.0f),
-		StepFactorOcclusion(1.0f)
+		StepFactorOcclusion(1.0f),
+		RenderMode(Enums::StochasticRayCasting),
+		OpacityThreshold(0.99f)
 	{
 	}
 	
@@ -65,7 +67,9 @@ public:
 		GradientMode(Enums::CentralDifferences),
 		AcceleratorType(Enums::Octree),
 		StepFactorPrimary(1.0f),
-		StepFactorOcclusion(1.0f)
+		StepFactorOcclusion(1.0f),
+		RenderMode(Enums::StochasticRayCasting),
+		OpacityThreshold(0.99f)
 	{
 		*this = Other;
 	}
@@ -91,6 +95,8 @@ public:
 		this->AcceleratorType		= Other.AcceleratorType;
 		this->StepFactorPrimary		= Other.StepFactorPrimary;
 		this->StepFactorOcclusion	= Other.StepFactorOcclusion;
+		this->RenderMode			= Other.RenderMode;
+		this->OpacityThreshold		= Other.OpacityThreshold;
 		
 		return *this;
 	}
@@ -164,6 +170,8 @@ public:
 	GET_SET_MACRO(HOST_DEVICE, AcceleratorType, Enums::AcceleratorType)
 	GET_SET_MACRO(HOST_DEVICE, StepFactorPrimary, float)
 	GET_SET_MACRO(HOST_DEVICE, StepFactorOcclusion, float)
+	GET_SET_MACRO(HOST_DEVICE, RenderMode, Enums::RenderMode)
+	GET_SET_MACRO(HOST_DEVICE, OpacityThreshold, float)
 
 protected:
 	ScalarTransferFunction1D	Opacity1D;					/*! Opacity transfer function */
@@ -181,6 +189,8 @@ protected:
 	Enums::AcceleratorType		AcceleratorType;			/*! Type of ray traversal accelerator */
 	float						StepFactorPrimary;			/*! Step factor for primary rays */
 	float						StepFactorOcclusion;		/*! Step factor for shadow rays */
+	Enums::RenderMode			RenderMode;					/*! Type of rendering e.g. standard or stochastic ray casting */
+	float						OpacityThreshold;			/*! Accumulated opacity at which standard ray casting terminates a ray */
 };
 
 }
@@ -34,6 +34,8 @@ public:
 	HOST Volume() :
 		Transform(),
 		BoundingBox(Vec3f(0.0f), Vec3f(1.0f)),
+		FullBoundingBox(Vec3f(0.0f), Vec3f(1.0f)),
+		Origin(0.0f),
 		Resolution(0),
 		Spacing(1.0f),
 		InvSpacing(1.0f),
@@ -71,6 +73,9 @@ public:
 		this->BoundingBox.SetMinP(Vec3f(0.0f, 0.0f, 0.0f));
 		this->BoundingBox.SetMaxP(this->Size);
 
+		this->FullBoundingBox	= this->BoundingBox;
+		this->Origin			= Vec3f(0.0f);
+
 		Cuda::HandleCudaError(cudaFree(this->Array));
 
 		this->Array = 0;
@@ -118,6 +123,18 @@ public:
 
 		
 	}
+
+	/*! Marks the volume as a brick of a larger volume, used for sort-last rendering. The voxel data (core plus ghost layers) starts at \a Origin, rays are only integrated within \a Core
+		@param[in] Origin World position of the first voxel of the brick data
+		@param[in] Core Bounding box of the region this brick is responsible for, excluding ghost layers
+		@param[in] Full Bounding box of the entire volume
+	*/
+	HOST void SetBrick(const Vec3f& Origin, const ExposureRender::BoundingBox& Core, const ExposureRender::BoundingBox& Full)
+	{
+		this->Origin			= Origin;
+		this->BoundingBox		= Core;
+		this->FullBoundingBox	= Full;
+	}
 	
 	/*! Gets the (interpolated) voxel value at \a P
 		@param[in] P Position in volume coordinate space
@@ -126,7 +143,7 @@ public:
 	DEVICE short GetIntensity(const Vec3f& P)
 	{
 #ifdef __CUDACC__
-		return tex3D<short>(this->TextureObject, P[0] * this->InvSize[0], P[1]* this->InvSize[1], P[2]* this->InvSize[2]);// * (float)SHRT_MAX;
+		return tex3D<short>(this->TextureObject, (P[0] - this->Origin[0]) * this->InvSize[0], (P[1] - this->Origin[1]) * this->InvSize[1], (P[2] - this->Origin[2]) * this->InvSize[2]);// * (float)SHRT_MAX;
 #else
 		return 0;
 #endif
@@ -138,6 +155,8 @@ public:
 
 	GET_SET_MACRO(HOST_DEVICE, Transform, Transform)
 	GET_MACRO(HOST_DEVICE, BoundingBox, BoundingBox)
+	GET_MACRO(HOST_DEVICE, FullBoundingBox, BoundingBox)
+	GET_MACRO(HOST_DEVICE, Origin, Vec3f)
 	GET_MACRO(HOST_DEVICE, Resolution, Vec3i)
 	GET_MACRO(HOST_DEVICE, Spacing, Vec3f)
 	GET_MACRO(HOST_DEVICE, InvSpacing, Vec3f)
@@ -158,6 +177,8 @@ private:
 	cudaArray*					Array;				/*! Cuda array, used by the texture object */
 	cudaTextureObject_t			TextureObject;		/*! Cuda texture object */
 	BoundingBox					BoundingBox;		/*! Encompassing bounding box */
+	BoundingBox					FullBoundingBox;	/*! Bounding box of the entire volume, differs from the bounding box when this volume is a brick */
+	Vec3f						Origin;				/*! World position of the first voxel */
 };
 
 }
\ No newline at end of file
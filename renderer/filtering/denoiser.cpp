@@ -0,0 +1,213 @@
+
+#include "filtering\denoiser.h"
+
+#include <QtConcurrentMap>
+
+#include <math.h>
+
+struct QDenoiserRow
+{
+	typedef void result_type;
+
+	QDenoiserRow(QDenoiser* Denoiser) :
+		Denoiser(Denoiser)
+	{
+	}
+
+	void operator()(const int& Y) const
+	{
+		this->Denoiser->FilterRow(Y);
+	}
+
+	QDenoiser* Denoiser;
+};
+
+QDenoiser::QDenoiser(QObject* Parent /*= 0*/) :
+	QObject(Parent),
+	Enabled(false),
+	NoIterations(5),
+	SigmaColor(0.5f),
+	SigmaNormal(0.1f),
+	SigmaDepth(0.05f),
+	SigmaAlbedo(0.1f),
+	MaxNoEstimates(64),
+	CurrentFilm(0),
+	Buffers(),
+	Sigmas(),
+	Rows(),
+	Current(0),
+	StepWidth(1)
+{
+}
+
+void QDenoiser::Denoise(Film& Film)
+{
+	if (!this->Enabled || this->NoIterations <= 0)
+		return;
+
+	HostBuffer2D<ColorRGBuc>& RunningEstimate = Film.GetHostRunningEstimate();
+	HostBuffer2D<Vec3f>& Normals = Film.GetHostNormals();
+	HostBuffer2D<int>& TileOffsets = Film.GetHostTileOffsets();
+
+	const Vec2i Resolution = Film.GetResolution();
+
+	this->Buffers[0].Resize(Resolution);
+	this->Buffers[1].Resize(Resolution);
+	this->Sigmas.Resize(Resolution);
+
+	if (this->Rows.size() != Resolution[1])
+	{
+		this->Rows.resize(Resolution[1]);
+
+		for (int Y = 0; Y < Resolution[1]; Y++)
+			this->Rows[Y] = Y;
+	}
+
+	bool Converged = true;
+
+	for (int Y = 0; Y < Resolution[1]; Y++)
+	{
+		for (int X = 0; X < Resolution[0]; X++)
+		{
+			const ColorRGBuc& Color = RunningEstimate(X, Y);
+
+			this->Buffers[0](X, Y) = ColorRGBf(ONE_OVER_255 * (float)Color[0], ONE_OVER_255 * (float)Color[1], ONE_OVER_255 * (float)Color[2]);
+
+			// The film counter is already incremented past the estimate that was just integrated
+			const int NoEstimates = qMax(Film.GetNoEstimates() - 1 - TileOffsets(X / FILM_TILE_SIZE, Y / FILM_TILE_SIZE), 1);
+
+			// Monte carlo noise falls off with the square root of the number of estimates, converged pixels are passed through unfiltered
+			this->Sigmas(X, Y) = NoEstimates > this->MaxNoEstimates ? 0.0f : this->SigmaColor / sqrtf((float)NoEstimates);
+
+			if (NoEstimates <= this->MaxNoEstimates)
+				Converged = false;
+
+			Vec3f& Normal = Normals(X, Y);
+
+			if (Normal.LengthSquared() > 0.0f)
+				Normal.Normalize();
+		}
+	}
+
+	if (Converged)
+		return;
+
+	this->CurrentFilm	= &Film;
+	this->Current		= 0;
+
+	for (int i = 0; i < this->NoIterations; i++)
+	{
+		this->StepWidth = 1 << i;
+
+		QtConcurrent::blockingMap(this->Rows, QDenoiserRow(this));
+
+		this->Current = 1 - this->Current;
+	}
+
+	for (int Y = 0; Y < Resolution[1]; Y++)
+	{
+		for (int X = 0; X < Resolution[0]; X++)
+		{
+			const ColorRGBf& Color = this->Buffers[this->Current](X, Y);
+
+			for (int c = 0; c < 3; c++)
+				RunningEstimate(X, Y)[c] = (unsigned char)Clamp((int)(255.0f * Color[c] + 0.5f), 0, 255);
+		}
+	}
+}
+
+void QDenoiser::FilterRow(const int& Y)
+{
+	// B3 spline kernel weights for offsets 0, 1 and 2
+	static const float Kernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+	const HostBuffer2D<ColorRGBf>& In	= this->Buffers[this->Current];
+	HostBuffer2D<ColorRGBf>& Out		= this->Buffers[1 - this->Current];
+
+	const HostBuffer2D<float>& Depth		= this->CurrentFilm->GetHostDepth();
+	const HostBuffer2D<Vec3f>& Normals		= this->CurrentFilm->GetHostNormals();
+	const HostBuffer2D<ColorXYZf>& Albedo	= this->CurrentFilm->GetHostAlbedo();
+
+	const int Width		= In.Width();
+	const int Height	= In.Height();
+
+	const float InvSigmaNormal		= 1.0f / this->SigmaNormal;
+	const float InvSigmaDepth		= 1.0f / this->SigmaDepth;
+	const float InvSigmaAlbedo2		= 1.0f / (this->SigmaAlbedo * this->SigmaAlbedo);
+
+	// Halve the color tolerance with every iteration, the coarser levels have less noise left
+	const float SigmaScale = 1.0f / (float)this->StepWidth;
+
+	for (int X = 0; X < Width; X++)
+	{
+		const ColorRGBf& CP = In(X, Y);
+
+		const float Sigma = this->Sigmas(X, Y) * SigmaScale;
+
+		if (Sigma <= 0.0f)
+		{
+			Out(X, Y) = CP;
+			continue;
+		}
+
+		const float InvSigmaColor2 = 1.0f / (Sigma * Sigma);
+
+		const float ZP			= Depth(X, Y);
+		const Vec3f& NP			= Normals(X, Y);
+		const ColorXYZf& AP		= Albedo(X, Y);
+
+		float Sum[3] = { 0.0f, 0.0f, 0.0f };
+		float SumWeight = 0.0f;
+
+		for (int KY = -2; KY <= 2; KY++)
+		{
+			const int QY = Y + KY * this->StepWidth;
+
+			if (QY < 0 || QY >= Height)
+				continue;
+
+			for (int KX = -2; KX <= 2; KX++)
+			{
+				const int QX = X + KX * this->StepWidth;
+
+				if (QX < 0 || QX >= Width)
+					continue;
+
+				const float ZQ = Depth(QX, QY);
+
+				// Never filter across the silhouette of the volume
+				if ((ZP > 0.0f) != (ZQ > 0.0f))
+					continue;
+
+				const ColorRGBf& CQ = In(QX, QY);
+
+				float Exponent = 0.0f;
+
+				for (int c = 0; c < 3; c++)
+					Exponent += (CP[c] - CQ[c]) * (CP[c] - CQ[c]) * InvSigmaColor2;
+
+				if (ZP > 0.0f)
+				{
+					const Vec3f& NQ			= Normals(QX, QY);
+					const ColorXYZf& AQ		= Albedo(QX, QY);
+
+					Exponent += qMax(0.0f, 1.0f - NP.Dot(NQ)) * InvSigmaNormal;
+					Exponent += fabsf(ZP - ZQ) / ZP * InvSigmaDepth;
+
+					for (int c = 0; c < 3; c++)
+						Exponent += (AP[c] - AQ[c]) * (AP[c] - AQ[c]) * InvSigmaAlbedo2;
+				}
+
+				const float Weight = Kernel[qAbs(KX)] * Kernel[qAbs(KY)] * expf(-Exponent);
+
+				for (int c = 0; c < 3; c++)
+					Sum[c] += Weight * CQ[c];
+
+				SumWeight += Weight;
+			}
+		}
+
+		// The center tap always contributes, so the sum of weights is never zero
+		Out(X, Y) = ColorRGBf(Sum[0] / SumWeight, Sum[1] / SumWeight, Sum[2] / SumWeight);
+	}
+}
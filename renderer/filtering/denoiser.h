@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QObject>
+#include <QVector>
+
+#include "buffer\buffers.h"
+#include "color\color.h"
+#include "core\film.h"
+
+using namespace ExposureRender;
+
+/*! Edge avoiding a-trous wavelet denoiser, guided by the depth, normal and albedo feature buffers of the film
+	The rows of each wavelet iteration are filtered in parallel on the global thread pool
+*/
+class QDenoiser : public QObject
+{
+    Q_OBJECT
+
+public:
+	QDenoiser(QObject* Parent = 0);
+	virtual ~QDenoiser() {};
+
+	void Denoise(Film& Film);
+	void FilterRow(const int& Y);
+
+public:
+	bool						Enabled;
+	int							NoIterations;
+	float						SigmaColor;
+	float						SigmaNormal;
+	float						SigmaDepth;
+	float						SigmaAlbedo;
+	int							MaxNoEstimates;
+
+private:
+	Film*						CurrentFilm;
+	HostBuffer2D<ColorRGBf>		Buffers[2];
+	HostBuffer2D<float>			Sigmas;
+	QVector<int>				Rows;
+	int							Current;
+	int							StepWidth;
+};
@@ -2,8 +2,10 @@
 #include "compositorsocket.h"
 #include "core\renderthread.h"
 
+#include <QApplication>
 #include <QImage>
 #include <QBuffer>
+#include <QElapsedTimer>
 
 #include <time.h>
 
@@ -13,52 +15,110 @@ QCompositorSocket::QCompositorSocket(QRenderer* Renderer, QObject* Parent /*= 0*
 	Renderer(Renderer),
 	ImageTimer(),
 	RenderStatsTimer(),
-	Estimate()
+	Estimate(),
+	EncodeTime(),
+	NoBackloggedImages(0),
+	SendBuffers(),
+	ResourceCache(QApplication::applicationDirPath() + "//resources"),
+	VolumeReceiver(this, &ResourceCache),
+	RelayServer(this),
+	RelaySocket(0),
+	RelayVolumeID(0)
 {
+	// A compositor on the same host receives the frames uncompressed through shared memory
+	this->SetSharedMemorySize(this->Settings.value("network/sharedmemory", 64).toInt() * 1024 * 1024);
+
 	connect(&this->ImageTimer, SIGNAL(timeout()), this, SLOT(OnSendImage()));
 	connect(&this->RenderStatsTimer, SIGNAL(timeout()), this, SLOT(OnSendRenderStats()));
 
 	this->Renderer->Start();
 
-	this->ImageTimer.start(1000.0f / this->Settings.value("network/sendimagefps ", 30).toInt());
-	this->RenderStatsTimer.start(1000.0f / this->Settings.value("network/sendrenderstatsfps ", 20).toInt());
+	this->RelayServer.Start();
+
+	this->ImageTimer.start(1000.0f / this->Settings.value("network/sendimagefps", 30).toInt());
+	this->RenderStatsTimer.start(1000.0f / this->Settings.value("network/sendrenderstatsfps", 20).toInt());
 };
 
-void QCompositorSocket::OnReceiveData(const QString& Action, QByteArray& Data)
+void QCompositorSocket::OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& Data)
 {
-	if (Action == "VOLUME" || Action == "BITMAP")
+	// The compositor pauses converged renderers, anything but a new sampling priority changes the image
+	if (Opcode == Protocol::Pause)
+	{
+		this->Pause();
+		return;
+	}
+
+	if (Opcode == Protocol::Volume || Opcode == Protocol::VolumeChunk)
 	{
-		qDebug() << "Received" << Action.toLower();
+		this->OnReceiveVolume(Opcode, Data, this);
+		return;
+	}
 
-		this->SaveResource(Data);
+	if (Opcode == Protocol::Relay)
+	{
+		this->SetRelay(Data);
+		return;
 	}
 
-	if (Action == "VOLUME")
+	if (Opcode != Protocol::Priority)
+		this->Resume();
+
+	if (Opcode == Protocol::Bitmap)
 	{
-		Volume& Volume = this->Renderer->Renderer.Volume;
+		qDebug() << "Received" << Protocol::GetName(Opcode);
 
 		QDataStream DataStream(&Data, QIODevice::ReadOnly);
 		DataStream.setVersion(QDataStream::Qt_4_0);
 
 		QString FileName;
-		Vec3i Resolution;
-		Vec3f Spacing;
+		QByteArray Bitmap;
 
 		DataStream >> FileName;
+		DataStream >> Bitmap;
 
-		DataStream >> Resolution[0];
-		DataStream >> Resolution[1];
-		DataStream >> Resolution[2];
+		this->ResourceCache.Store(QResourceCache::GetHash(Bitmap), Bitmap);
+	}
+
+	if (Opcode == Protocol::Brick)
+	{
+		QDataStream DataStream(&Data, QIODevice::ReadOnly);
+		DataStream.setVersion(QDataStream::Qt_4_0);
+
+		Vec3i FullResolution, Offset, Resolution, CoreMin, CoreMax;
+		Vec3f Spacing;
+		QByteArray Voxels;
+
+		for (int i = 0; i < 3; i++)
+			DataStream >> FullResolution[i];
 
-		DataStream >> Spacing[0];
-		DataStream >> Spacing[1];
-		DataStream >> Spacing[2];
+		for (int i = 0; i < 3; i++)
+			DataStream >> Spacing[i];
 
-		this->Renderer->Renderer.Volume.Create(Resolution, Spacing, (short*)Data.data());
+		for (int i = 0; i < 3; i++)
+			DataStream >> Offset[i];
+
+		for (int i = 0; i < 3; i++)
+			DataStream >> Resolution[i];
+
+		for (int i = 0; i < 3; i++)
+			DataStream >> CoreMin[i];
+
+		for (int i = 0; i < 3; i++)
+			DataStream >> CoreMax[i];
+
+		DataStream >> Voxels;
+
+		if (Voxels.count() != Resolution.CumulativeProduct() * (int)sizeof(short))
+		{
+			qDebug() << "Brick voxel data does not match its resolution";
+			return;
+		}
+
+		this->Renderer->SetBrick(Resolution, Spacing, (short*)Voxels.data(), FullResolution, Offset, CoreMin, CoreMax);
 	}
 
 	
-	if (Action == "CAMERA")
+	if (Opcode == Protocol::Camera)
 	{
 		float Position[3], FocalPoint[3], ViewUp[3];
 
@@ -77,11 +137,82 @@ void QCompositorSocket::OnReceiveData(const QString& Action, QByteArray& Data)
 		DataStream >> ViewUp[1];
 		DataStream >> ViewUp[2];
 
-		this->Renderer->Renderer.Camera.SetPos(Vec3f(Position));
-		this->Renderer->Renderer.Camera.SetTarget(Vec3f(FocalPoint));
-		this->Renderer->Renderer.Camera.SetUp(Vec3f(ViewUp));
-		
-		this->Renderer->Renderer.Camera.GetFilm().Restart();
+		quint32 Epoch = 0;
+
+		DataStream >> Epoch;
+
+		this->Renderer->SetCamera(Vec3f(Position), Vec3f(FocalPoint), Vec3f(ViewUp), Epoch);
+	}
+
+	if (Opcode == Protocol::Crop)
+	{
+		Vec2i FullResolution, Offset, Resolution;
+
+		QDataStream DataStream(&Data, QIODevice::ReadOnly);
+		DataStream.setVersion(QDataStream::Qt_4_0);
+
+		DataStream >> FullResolution[0];
+		DataStream >> FullResolution[1];
+
+		DataStream >> Offset[0];
+		DataStream >> Offset[1];
+
+		DataStream >> Resolution[0];
+		DataStream >> Resolution[1];
+
+		this->Renderer->SetCrop(FullResolution, Offset, Resolution);
+	}
+
+	if (Opcode == Protocol::Priority)
+	{
+		QDataStream DataStream(&Data, QIODevice::ReadOnly);
+		DataStream.setVersion(QDataStream::Qt_4_0);
+
+		int MapTileSize = 0;
+		Vec2i NoTiles;
+		QByteArray Priorities;
+
+		DataStream >> MapTileSize;
+		DataStream >> NoTiles[0];
+		DataStream >> NoTiles[1];
+		DataStream >> Priorities;
+
+		HostBuffer2D<unsigned char> Map;
+
+		if (Priorities.count() == NoTiles[0] * NoTiles[1])
+		{
+			Map.Resize(NoTiles);
+			memcpy(Map.GetData(), Priorities.data(), Priorities.count());
+		}
+
+		this->Renderer->SetPriorityMap(MapTileSize, Map);
+	}
+
+	if (Opcode == Protocol::Session)
+	{
+		QDataStream DataStream(&Data, QIODevice::ReadOnly);
+		DataStream.setVersion(QDataStream::Qt_4_0);
+
+		int SessionID = 0;
+
+		DataStream >> SessionID;
+
+		qDebug() << "Rendering for session" << SessionID;
+
+		// The compositor drops estimates of other sessions, and the sampling priorities of the previous session do not apply
+		this->Estimate.SetSessionID(SessionID);
+		this->Renderer->SetPriorityMap(0, HostBuffer2D<unsigned char>());
+
+		// View epochs are counted per gui, the film shows a view of the previous session until the camera of this one arrives
+		this->Renderer->ViewEpoch		= 0;
+		this->Renderer->RenderedEpoch	= 0;
+	}
+
+	if (Opcode == Protocol::Radiance)
+	{
+		qDebug() << "Sending radiance with the estimates";
+
+		this->Renderer->Renderer.Camera.GetFilm().SetOutputRadiance(true);
 	}
 	/*
 	if (Action == "IMAGE_SIZE")
@@ -102,16 +233,238 @@ void QCompositorSocket::OnReceiveData(const QString& Action, QByteArray& Data)
 	*/
 }
 
+void QCompositorSocket::Pause()
+{
+	if (!this->Renderer->RenderTimer.isActive())
+		return;
+
+	qDebug() << "Image converged, pausing";
+
+	this->Renderer->Stop();
+	this->ImageTimer.stop();
+}
+
+void QCompositorSocket::Resume()
+{
+	if (this->Renderer->RenderTimer.isActive())
+		return;
+
+	qDebug() << "Resuming";
+
+	this->Renderer->Start();
+	this->ImageTimer.start(1000.0f / this->Settings.value("network/sendimagefps", 30).toInt());
+}
+
+void QCompositorSocket::OnReceiveVolume(const Protocol::Opcode& Opcode, QByteArray& Data, QBaseSocket* Source)
+{
+	QVolumeSender* RelaySender = this->RelaySocket ? &this->RelaySocket->VolumeSender : 0;
+
+	// The old volume is rendered while a new one streams in, only the complete volume changes the image
+	if (Opcode == Protocol::Volume)
+	{
+		// The relay reads from the voxel buffer that is about to be replaced
+		if (RelaySender)
+			RelaySender->Stop();
+
+		this->VolumeReceiver.SetSocket(Source);
+
+		// A cached volume is complete as soon as its header arrives
+		const bool Cached = this->VolumeReceiver.OnHeader(Data);
+
+		this->StartRelay();
+
+		if (Cached)
+			this->OnVolumeReceived();
+
+		return;
+	}
+
+	const bool Complete = this->VolumeReceiver.OnChunk(Data);
+
+	if (RelaySender && RelaySender->IsBusy())
+		RelaySender->SetNoAvailableChunks(this->VolumeReceiver.GetNoChunks());
+
+	if (Complete)
+		this->OnVolumeReceived();
+}
+
+void QCompositorSocket::OnVolumeReceived()
+{
+	QVolumeSender* RelaySender = this->RelaySocket ? &this->RelaySocket->VolumeSender : 0;
+
+	const QVolumeInfo& Info = this->VolumeReceiver.GetInfo();
+
+	qDebug() << "Received volume" << Info.FileName;
+
+	this->Renderer->SetVolume(Info.Resolution, Info.Spacing, (short*)this->VolumeReceiver.GetVoxels().constData());
+
+	// The device holds the volume now, the host copy is only kept until the next renderer in the chain has it
+	if (!RelaySender || !RelaySender->IsBusy())
+		this->VolumeReceiver.Release();
+
+	this->Resume();
+}
+
+void QCompositorSocket::SetRelay(QByteArray& Data)
+{
+	QDataStream DataStream(&Data, QIODevice::ReadOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	QString Host;
+	quint16 Port = 0;
+
+	DataStream >> Host;
+	DataStream >> Port;
+	DataStream >> this->RelayVolumeID;
+
+	const bool Connected = this->RelaySocket && this->RelaySocket->state() != QAbstractSocket::UnconnectedState;
+
+	if (Connected && this->RelaySocket->peerName() == Host && this->RelaySocket->peerPort() == Port)
+	{
+		this->StartRelay();
+		return;
+	}
+
+	if (this->RelaySocket)
+	{
+		this->RelaySocket->VolumeSender.Stop();
+		this->RelaySocket->deleteLater();
+
+		this->RelaySocket = 0;
+
+		this->OnRelayFinished();
+	}
+
+	// The last renderer in the chain does not forward the volume
+	if (Host.isEmpty())
+		return;
+
+	this->RelaySocket = new QRelaySocket(this, this);
+
+	connect(&this->RelaySocket->VolumeSender, SIGNAL(Finished()), this, SLOT(OnRelayFinished()));
+	connect(this->RelaySocket, SIGNAL(disconnected()), this, SLOT(OnRelayFinished()));
+	connect(this->RelaySocket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(OnRelayFinished()));
+
+	qDebug() << "Relaying volumes to" << Host << "on port" << Port;
+
+	this->RelaySocket->connectToHost(Host, Port);
+
+	// The volume may already be streaming in from the previous renderer, the relay instruction travels on another connection
+	this->StartRelay();
+}
+
+void QCompositorSocket::StartRelay()
+{
+	const QVolumeInfo& Info = this->VolumeReceiver.GetInfo();
+
+	if (!this->RelaySocket || this->RelaySocket->VolumeSender.IsBusy() || Info.ID != this->RelayVolumeID || this->VolumeReceiver.GetVoxels().isEmpty())
+		return;
+
+	// Chunks are forwarded to the next renderer in the chain straight from the voxel buffer, as soon as they have been verified
+	const QByteArray& Voxels = this->VolumeReceiver.GetVoxels();
+
+	this->RelaySocket->VolumeSender.Start(Info, QByteArray::fromRawData(Voxels.constData(), Voxels.size()));
+	this->RelaySocket->VolumeSender.SetNoAvailableChunks(this->VolumeReceiver.GetNoChunks());
+}
+
+void QCompositorSocket::OnRelayFinished()
+{
+	// The host copy is released once the next renderer has the volume, or can no longer get it from here
+	if (this->RelaySocket && this->RelaySocket->state() == QAbstractSocket::ConnectedState && this->RelaySocket->VolumeSender.IsBusy())
+		return;
+
+	if (this->RelaySocket)
+	{
+		if (this->RelaySocket->VolumeSender.IsBusy())
+			qDebug() << "Relay to" << this->RelaySocket->peerName() << "failed";
+
+		this->RelaySocket->VolumeSender.Stop();
+	}
+
+	if (this->VolumeReceiver.IsComplete())
+		this->VolumeReceiver.Release();
+}
+
 void QCompositorSocket::OnSendImage()
 {
-	this->Estimate.GetBuffer() = this->Renderer->Renderer.Camera.GetFilm().GetHostRunningEstimate();
+	// While the previous frame is still queued the link is the bottleneck, encoding another one would only add latency
+	if (this->IsQueued(Protocol::Estimate))
+	{
+		this->NoBackloggedImages++;
+		return;
+	}
+
+	// Until the latest camera has been rendered the film still shows the previous view, which the compositor would drop anyway
+	if (this->Renderer->RenderedEpoch != this->Renderer->ViewEpoch)
+		return;
 
-	QByteArray CompressedImage;
+	Film& Film = this->Renderer->Renderer.Camera.GetFilm();
 
-	if (this->Estimate.ToByteArray(CompressedImage))
-		this->SendData("ESTIMATE", CompressedImage);
+	this->Estimate.GetBuffer() = Film.GetHostRunningEstimate();
+	this->Estimate.GetOpacity() = Film.GetHostRunningOpacity();
+
+	if (Film.GetOutputRadiance())
+	{
+		// Means rather than sums keep the shared exponent encoding in range, the compositor recovers the weights from the per tile sample counts
+		HostBuffer2D<int>& TileOffsets		= Film.GetHostTileOffsets();
+		HostBuffer2D<ColorXYZf>& Sums		= Film.GetHostAccumulatedRadiance();
+		HostBuffer2D<int>& SampleCounts		= this->Estimate.GetSampleCounts();
+		HostBuffer2D<ColorXYZf>& Radiance	= this->Estimate.GetRadiance();
+
+		SampleCounts.Resize(TileOffsets.GetResolution());
+		Radiance.Resize(Sums.GetResolution());
+
+		for (int i = 0; i < SampleCounts.GetNoElements(); i++)
+			SampleCounts[i] = qMax(Film.GetNoEstimates() - 1 - TileOffsets[i], 0);
+
+		for (int Y = 0; Y < Radiance.Height(); Y++)
+		{
+			for (int X = 0; X < Radiance.Width(); X++)
+			{
+				const int NoSamples = SampleCounts(X / FILM_TILE_SIZE, Y / FILM_TILE_SIZE);
+
+				Radiance(X, Y) = NoSamples > 0 ? Sums(X, Y) / (float)NoSamples : ColorXYZf();
+			}
+		}
+
+		this->Estimate.SetTileSize(FILM_TILE_SIZE);
+	}
+	this->Estimate.SetOffset(Film.GetOffset());
+	this->Estimate.SetNoEstimates(Film.GetNoEstimates() - 1);
+	this->Estimate.SetEpoch(this->Renderer->RenderedEpoch);
+	this->Estimate.SetRaw(this->IsSharedMemory());
+
+	// The estimate is serialized into a pooled buffer and queued for sending without a copy
+	QByteArray CompressedImage = this->SendBuffers.Acquire();
+
+	QElapsedTimer Timer;
+
+	Timer.start();
+
+	const bool Encoded = this->Estimate.ToByteArray(CompressedImage);
+
+	this->EncodeTime.PushValue((float)Timer.nsecsElapsed() / 1000000.0f);
+
+	if (Encoded)
+		this->SendData(Protocol::Estimate, CompressedImage);
+
+	this->SendBuffers.Release(CompressedImage);
 }
 
 void QCompositorSocket::OnSendRenderStats()
 {
+	QByteArray Data;
+
+	QDataStream DataStream(&Data, QIODevice::WriteOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	DataStream << this->Renderer->DeviceName;
+	DataStream << this->Renderer->SamplesPerSecond.GetAverageValue();
+	DataStream << this->Renderer->RenderTime.GetAverageValue();
+	DataStream << this->EncodeTime.GetAverageValue();
+	DataStream << (qint32)this->GetQueueDepth();
+	DataStream << this->NoBackloggedImages + this->GetNoReplacedMessages();
+	DataStream << this->RelayServer.serverPort();
+
+	this->SendData(Protocol::RenderStats, Data);
 }
\ No newline at end of file
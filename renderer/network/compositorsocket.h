@@ -5,6 +5,10 @@
 #include "utilities\network\basesocket.h"
 #include "utilities\general\hysteresis.h"
 #include "utilities\general\estimate.h"
+#include "utilities\network\sendbufferpool.h"
+#include "utilities\network\volumetransfer.h"
+#include "relayserver.h"
+#include "relaysocket.h"
 
 class QRenderer;
 
@@ -15,11 +19,20 @@ class QCompositorSocket : public QBaseSocket
 public:
 	QCompositorSocket(QRenderer* Renderer, QObject* Parent = 0);
 
-	void OnReceiveData(const QString& Action, QByteArray& Data);
+	void OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& Data);
+	void OnReceiveVolume(const Protocol::Opcode& Opcode, QByteArray& Data, QBaseSocket* Source);
+	void Pause();
+	void Resume();
 
 public slots:
 	void OnSendImage();
 	void OnSendRenderStats();
+	void OnRelayFinished();
+
+private:
+	void SetRelay(QByteArray& Data);
+	void StartRelay();
+	void OnVolumeReceived();
 
 public:
 	QSettings 			Settings;
@@ -27,4 +40,12 @@ public:
 	QTimer				ImageTimer;
 	QTimer				RenderStatsTimer;
 	QEstimate			Estimate;
+	QHysteresis			EncodeTime;
+	quint32				NoBackloggedImages;
+	QSendBufferPool		SendBuffers;
+	QResourceCache		ResourceCache;
+	QVolumeReceiver		VolumeReceiver;
+	QRelayServer		RelayServer;
+	QRelaySocket*		RelaySocket;
+	quint32				RelayVolumeID;
 };
\ No newline at end of file
@@ -0,0 +1,30 @@
+
+#include "relayserver.h"
+#include "relaysocket.h"
+
+QRelayServer::QRelayServer(QCompositorSocket* CompositorSocket, QObject* Parent /*= 0*/) :
+	QBaseServer("Relay", Parent),
+	Settings("renderer.ini", QSettings::IniFormat),
+	CompositorSocket(CompositorSocket)
+{
+	this->ListenPort = this->Settings.value("network/relayport", 6002).toInt();
+}
+
+void QRelayServer::OnNewConnection(const int& SocketDescriptor)
+{
+	QRelaySocket* RelaySocket = new QRelaySocket(this->CompositorSocket, this);
+
+	if (!RelaySocket->setSocketDescriptor(SocketDescriptor))
+	{
+		delete RelaySocket;
+		return;
+	}
+
+	connect(RelaySocket, SIGNAL(disconnected()), RelaySocket, SLOT(deleteLater()));
+
+	qDebug() << "Relay connection from" << RelaySocket->peerAddress().toString();
+}
+
+void QRelayServer::OnStarted()
+{
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "utilities\network\baseserver.h"
+
+#include <QSettings>
+
+class QCompositorSocket;
+
+/*! Accepts the connection of the renderer that precedes this one in a volume relay chain */
+class QRelayServer : public QBaseServer
+{
+	Q_OBJECT
+
+public:
+	QRelayServer(QCompositorSocket* CompositorSocket, QObject* Parent = 0);
+
+protected:
+	void OnNewConnection(const int& SocketDescriptor);
+	void OnStarted();
+
+private:
+	QSettings			Settings;
+	QCompositorSocket*	CompositorSocket;
+};
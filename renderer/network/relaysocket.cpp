@@ -0,0 +1,37 @@
+
+#include "relaysocket.h"
+#include "compositorsocket.h"
+
+#include <QSettings>
+
+QRelaySocket::QRelaySocket(QCompositorSocket* CompositorSocket, QObject* Parent /*= 0*/) :
+	QBaseSocket(Parent),
+	CompositorSocket(CompositorSocket),
+	VolumeSender(this)
+{
+	QSettings Settings("renderer.ini", QSettings::IniFormat);
+
+	// Renderers on the same host relay the volume through shared memory
+	this->SetSharedMemorySize(Settings.value("network/sharedmemory", 64).toInt() * 1024 * 1024);
+
+	connect(this, SIGNAL(connected()), this, SLOT(OnConnected()));
+}
+
+void QRelaySocket::OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& Data)
+{
+	if (Opcode == Protocol::VolumeAck)
+	{
+		this->VolumeSender.OnAcknowledge(Data);
+		return;
+	}
+
+	if (Opcode == Protocol::Volume || Opcode == Protocol::VolumeChunk)
+		this->CompositorSocket->OnReceiveVolume(Opcode, Data, this);
+}
+
+void QRelaySocket::OnConnected()
+{
+	// The volume header may have arrived before the connection to the next renderer was up
+	if (this->VolumeSender.IsBusy())
+		this->VolumeSender.Resume();
+}
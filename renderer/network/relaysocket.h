@@ -0,0 +1,26 @@
+#pragma once
+
+#include "utilities\network\basesocket.h"
+#include "utilities\network\volumetransfer.h"
+
+class QCompositorSocket;
+
+/*! Connection between neighbouring renderers in a volume relay chain
+	The upstream renderer forwards the volume chunks it receives, the downstream renderer acknowledges them on the same connection
+*/
+class QRelaySocket : public QBaseSocket
+{
+    Q_OBJECT
+
+public:
+	QRelaySocket(QCompositorSocket* CompositorSocket, QObject* Parent = 0);
+
+	void OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& Data);
+
+private slots:
+	void OnConnected();
+
+public:
+	QCompositorSocket*	CompositorSocket;
+	QVolumeSender		VolumeSender;
+};
@@ -0,0 +1,96 @@
+#include "general\voxelcodec.h"
+
+#include <QtCore>
+
+#include <math.h>
+
+/*! Compresses and decompresses synthetic volumes with the voxel codec, returns the number of volumes that did not survive the round trip */
+
+static const int Width	= 256;
+static const int Height	= 230;
+static const int Depth	= 256;
+
+static bool Run(const QString& Name, const QByteArray& Voxels, const int& NoRepetitions)
+{
+	QByteArray Compressed, Decompressed;
+
+	QElapsedTimer Timer;
+
+	Timer.start();
+
+	for (int r = 0; r < NoRepetitions; r++)
+		Compressed = QVoxelCodec::Compress(Voxels);
+
+	const float CompressTime = (float)Timer.nsecsElapsed() / 1000000000.0f;
+
+	Timer.restart();
+
+	bool Decoded = true;
+
+	for (int r = 0; r < NoRepetitions; r++)
+		Decoded = QVoxelCodec::Decompress(Compressed, Decompressed) && Decoded;
+
+	const float DecompressTime = (float)Timer.nsecsElapsed() / 1000000000.0f;
+
+	const bool Exact = Decoded && Decompressed == Voxels;
+
+	const float NoBytes = (float)Voxels.size() * (float)NoRepetitions;
+
+	qDebug() << qPrintable(QString("%1: ratio %2, compress %3 GB/s, decompress %4 GB/s, %5").arg(Name, -12).arg((float)Voxels.size() / (float)qMax(Compressed.size(), 1), 0, 'f', 2).arg(NoBytes / qMax(CompressTime, 1e-9f) / 1e9f, 0, 'f', 2).arg(NoBytes / qMax(DecompressTime, 1e-9f) / 1e9f, 0, 'f', 2).arg(Exact ? "exact" : "MISMATCH"));
+
+	return Exact;
+}
+
+int main(int argc, char **argv)
+{
+	const int NoRepetitions = argc > 1 ? qMax(QString(argv[1]).toInt(), 1) : 5;
+
+	qDebug() << "Benchmarking voxel codec on" << Width << "x" << Height << "x" << Depth << "voxels," << NoRepetitions << "repetitions," << QThread::idealThreadCount() << "threads";
+
+	QByteArray Voxels(Width * Height * Depth * sizeof(short), 0);
+
+	short* Data = (short*)Voxels.data();
+
+	int NoFailures = 0;
+
+	qsrand(1);
+
+	// Air outside an ellipsoid of noisy soft tissue in a shell of bone, roughly what a ct scan looks like to the codec
+	for (int Z = 0; Z < Depth; Z++)
+	{
+		for (int Y = 0; Y < Height; Y++)
+		{
+			for (int X = 0; X < Width; X++)
+			{
+				const float DX = (X - Width / 2) / 110.0f, DY = (Y - Height / 2) / 100.0f, DZ = (Z - Depth / 2) / 120.0f;
+				const float R = sqrtf(DX * DX + DY * DY + DZ * DZ);
+
+				short Value = -1024;
+
+				if (R < 1.0f)
+					Value = 40 + (short)(20.0f * sinf(X * 0.05f) * cosf(Y * 0.07f)) + (qrand() % 16 - 8);
+
+				if (R > 0.92f && R < 1.0f)
+					Value = 700 + qrand() % 64;
+
+				Data[(Z * Height + Y) * Width + X] = Value;
+			}
+		}
+	}
+
+	NoFailures += Run("phantom", Voxels, NoRepetitions) ? 0 : 1;
+
+	// Empty space, the best case
+	for (int i = 0; i < Width * Height * Depth; i++)
+		Data[i] = -1024;
+
+	NoFailures += Run("air", Voxels, NoRepetitions) ? 0 : 1;
+
+	// Uniform noise, the worst case, which must not expand beyond the block headers
+	for (int i = 0; i < Width * Height * Depth; i++)
+		Data[i] = (short)(((qrand() << 8) ^ qrand()) & 0xffff);
+
+	NoFailures += Run("noise", Voxels, NoRepetitions) ? 0 : 1;
+
+	return NoFailures;
+}
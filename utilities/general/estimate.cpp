@@ -4,9 +4,74 @@
 #include <QDataStream>
 #include <QDebug>
 
+#include <math.h>
+
+/*! Encodes the mean radiance as shared exponent (RGBE) bytes, four per pixel instead of twelve
+	@param[in] Radiance Mean radiance
+	@return Encoded radiance
+*/
+static QByteArray EncodeRadiance(const HostBuffer2D<ColorXYZf>& Radiance)
+{
+	QByteArray Data(Radiance.GetNoElements() * 4, 0);
+
+	unsigned char* Bytes = (unsigned char*)Data.data();
+
+	for (int i = 0; i < Radiance.GetNoElements(); i++)
+	{
+		const ColorXYZf& XYZ = Radiance[i];
+
+		const float Max = qMax(qMax(XYZ[0], XYZ[1]), XYZ[2]);
+
+		if (Max < 1e-32f)
+			continue;
+
+		int Exponent = 0;
+
+		const float Scale = frexpf(Max, &Exponent) * 256.0f / Max;
+
+		for (int c = 0; c < 3; c++)
+			Bytes[i * 4 + c] = (unsigned char)qMax(XYZ[c] * Scale, 0.0f);
+
+		Bytes[i * 4 + 3] = (unsigned char)(Exponent + 128);
+	}
+
+	return Data;
+}
+
+/*! Decodes shared exponent (RGBE) bytes into mean radiance
+	@param[in] Data Encoded radiance
+	@param[out] Radiance Mean radiance, sized beforehand
+*/
+static void DecodeRadiance(const QByteArray& Data, HostBuffer2D<ColorXYZf>& Radiance)
+{
+	const unsigned char* Bytes = (const unsigned char*)Data.constData();
+
+	for (int i = 0; i < Radiance.GetNoElements(); i++)
+	{
+		if (Bytes[i * 4 + 3] == 0)
+		{
+			Radiance[i] = ColorXYZf();
+			continue;
+		}
+
+		const float Scale = ldexpf(1.0f, (int)Bytes[i * 4 + 3] - (128 + 8));
+
+		Radiance[i] = ColorXYZf((Bytes[i * 4] + 0.5f) * Scale, (Bytes[i * 4 + 1] + 0.5f) * Scale, (Bytes[i * 4 + 2] + 0.5f) * Scale);
+	}
+}
+
 QEstimate::QEstimate(QObject* Parent /*= 0*/) :
 	QObject(Parent),
 	Buffer(),
+	Opacity(),
+	Radiance(),
+	SampleCounts(),
+	TileSize(0),
+	Offset(0, 0),
+	NoEstimates(0),
+	SessionID(0),
+	Epoch(0),
+	Raw(false),
 	GpuJpegEncoder(),
 	GpuJpegDecoder()
 {
@@ -48,8 +113,95 @@ bool QEstimate::Decode(QByteArray& Data)
 
 	DataStream >> Width;
 	DataStream >> Height;
+	DataStream >> this->Offset[0];
+	DataStream >> this->Offset[1];
+	DataStream >> this->NoEstimates;
+	DataStream >> this->SessionID;
+	DataStream >> this->Epoch;
+	DataStream >> this->Raw;
 	DataStream >> CompressedImageBytes;
 
+	bool HasOpacity = false;
+
+	DataStream >> HasOpacity;
+
+	if (HasOpacity)
+	{
+		QByteArray CompressedOpacity;
+
+		DataStream >> CompressedOpacity;
+
+		const QByteArray OpacityBytes = this->Raw ? CompressedOpacity : qUncompress(CompressedOpacity);
+
+		if (OpacityBytes.count() != Width * Height)
+		{
+			qDebug() << "Unable to decode, opacity does not match the image size";
+			return false;
+		}
+
+		this->Opacity.Resize(Vec2i(Width, Height));
+		memcpy(this->Opacity.GetData(), OpacityBytes.data(), OpacityBytes.count());
+	}
+	else
+	{
+		this->Opacity.Free();
+	}
+
+	bool HasRadiance = false;
+
+	DataStream >> HasRadiance;
+
+	if (HasRadiance)
+	{
+		Vec2i NoTiles;
+		QByteArray CompressedSampleCounts, CompressedRadiance;
+
+		DataStream >> this->TileSize;
+		DataStream >> NoTiles[0];
+		DataStream >> NoTiles[1];
+		DataStream >> CompressedSampleCounts;
+		DataStream >> CompressedRadiance;
+
+		const QByteArray SampleCountBytes	= this->Raw ? CompressedSampleCounts : qUncompress(CompressedSampleCounts);
+		const QByteArray RadianceBytes		= this->Raw ? CompressedRadiance : qUncompress(CompressedRadiance);
+
+		if (SampleCountBytes.count() != NoTiles[0] * NoTiles[1] * (int)sizeof(int) || RadianceBytes.count() != Width * Height * (this->Raw ? (int)sizeof(ColorXYZf) : 4))
+		{
+			qDebug() << "Unable to decode, radiance does not match the image size";
+			return false;
+		}
+
+		this->SampleCounts.Resize(NoTiles);
+		memcpy(this->SampleCounts.GetData(), SampleCountBytes.data(), SampleCountBytes.count());
+
+		this->Radiance.Resize(Vec2i(Width, Height));
+
+		if (this->Raw)
+			memcpy(this->Radiance.GetData(), RadianceBytes.data(), RadianceBytes.count());
+		else
+			DecodeRadiance(RadianceBytes, this->Radiance);
+	}
+	else
+	{
+		this->Radiance.Free();
+		this->SampleCounts.Free();
+	}
+
+	// Peers on the same host exchange the pixels as they are, memory bandwidth is cheaper than the codec
+	if (this->Raw)
+	{
+		if (CompressedImageBytes.count() != Width * Height * (int)sizeof(ColorRGBuc))
+		{
+			qDebug() << "Unable to decode, image does not match its size";
+			return false;
+		}
+
+		this->Buffer.Resize(Vec2i(Width, Height));
+		memcpy(this->Buffer.GetData(), CompressedImageBytes.data(), CompressedImageBytes.count());
+
+		return true;
+	}
+
 	GpuJpegDecoder.Decode((unsigned char*)CompressedImageBytes.data(), CompressedImageBytes.count(), Width, Height, NoBytes);
 		
 	unsigned char* ImageData = GpuJpegDecoder.GetImage(NoBytes);
@@ -64,7 +216,12 @@ bool QEstimate::ToByteArray(QByteArray& Data)
 {
 	QByteArray EncodedImage;
 
-	if (!this->Encode(EncodedImage))
+	if (this->Raw && this->Buffer.GetResolution().CumulativeProduct() == 0)
+		return false;
+
+	if (this->Raw)
+		EncodedImage = QByteArray::fromRawData((const char*)this->Buffer.GetData(), this->Buffer.GetNoBytes());
+	else if (!this->Encode(EncodedImage))
 		return false;
 
 	QDataStream DataStream(&Data, QIODevice::WriteOnly);
@@ -72,8 +229,50 @@ bool QEstimate::ToByteArray(QByteArray& Data)
 
 	DataStream << this->Buffer.Width();
 	DataStream << this->Buffer.Height();
+	DataStream << this->Offset[0];
+	DataStream << this->Offset[1];
+	DataStream << this->NoEstimates;
+	DataStream << this->SessionID;
+	DataStream << this->Epoch;
+	DataStream << this->Raw;
 	DataStream << EncodedImage;
 
+	// The opacity plane is mostly empty or opaque, so it compresses well losslessly
+	const bool HasOpacity = !this->Opacity.IsEmpty();
+
+	DataStream << HasOpacity;
+
+	if (HasOpacity)
+	{
+		const QByteArray OpacityBytes = QByteArray::fromRawData((const char*)this->Opacity.GetData(), this->Opacity.GetNoBytes());
+
+		DataStream << (this->Raw ? OpacityBytes : qCompress(OpacityBytes));
+	}
+
+	// Mean radiance plus per tile sample counts let the compositor weigh renderers by their progress and tone map only once
+	const bool HasRadiance = !this->Radiance.IsEmpty() && !this->SampleCounts.IsEmpty();
+
+	DataStream << HasRadiance;
+
+	if (HasRadiance)
+	{
+		DataStream << this->TileSize;
+		DataStream << this->SampleCounts.Width();
+		DataStream << this->SampleCounts.Height();
+		const QByteArray SampleCountBytes = QByteArray::fromRawData((const char*)this->SampleCounts.GetData(), this->SampleCounts.GetNoBytes());
+
+		if (this->Raw)
+		{
+			DataStream << SampleCountBytes;
+			DataStream << QByteArray::fromRawData((const char*)this->Radiance.GetData(), this->Radiance.GetNoBytes());
+		}
+		else
+		{
+			DataStream << qCompress(SampleCountBytes);
+			DataStream << qCompress(EncodeRadiance(this->Radiance));
+		}
+	}
+
 	return true;
 }
 
@@ -81,3 +280,35 @@ bool QEstimate::FromByteArray(QByteArray& Data)
 {
 	return this->Decode(Data);
 }
+
+int QEstimate::GetSessionID(QByteArray& Data)
+{
+	QDataStream DataStream(&Data, QIODevice::ReadOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	// The session follows the resolution, offset and number of estimates in the fixed size header
+	int Header[6] = { 0, 0, 0, 0, 0, 0 };
+
+	for (int i = 0; i < 6; i++)
+		DataStream >> Header[i];
+
+	return Header[5];
+}
+
+quint32 QEstimate::GetEpoch(QByteArray& Data)
+{
+	QDataStream DataStream(&Data, QIODevice::ReadOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	// The view epoch follows the fixed size header, estimates of a previous view are dropped without decoding them
+	int Header[6];
+
+	for (int i = 0; i < 6; i++)
+		DataStream >> Header[i];
+
+	quint32 Epoch = 0;
+
+	DataStream >> Epoch;
+
+	return Epoch;
+}
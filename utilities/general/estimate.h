@@ -20,11 +20,37 @@ public:
 	bool Decode(QByteArray& Data);
 	bool ToByteArray(QByteArray& Data);
 	bool FromByteArray(QByteArray& Data);
+	static int GetSessionID(QByteArray& Data);
+	static quint32 GetEpoch(QByteArray& Data);
 
 	HostBuffer2D<ColorRGBuc>& GetBuffer() { return this->Buffer; }
+	HostBuffer2D<unsigned char>& GetOpacity() { return this->Opacity; }
+	HostBuffer2D<ColorXYZf>& GetRadiance() { return this->Radiance; }
+	HostBuffer2D<int>& GetSampleCounts() { return this->SampleCounts; }
+	int GetTileSize() const { return this->TileSize; }
+	void SetTileSize(const int& TileSize) { this->TileSize = TileSize; }
+	Vec2i GetOffset() const { return this->Offset; }
+	void SetOffset(const Vec2i& Offset) { this->Offset = Offset; }
+	int GetNoEstimates() const { return this->NoEstimates; }
+	void SetNoEstimates(const int& NoEstimates) { this->NoEstimates = NoEstimates; }
+	bool IsRaw() const { return this->Raw; }
+	void SetRaw(const bool& Raw) { this->Raw = Raw; }
+	int GetSessionID() const { return this->SessionID; }
+	void SetSessionID(const int& SessionID) { this->SessionID = SessionID; }
+	quint32 GetEpoch() const { return this->Epoch; }
+	void SetEpoch(const quint32& Epoch) { this->Epoch = Epoch; }
 
 private:
 	HostBuffer2D<ColorRGBuc>	Buffer;
+	HostBuffer2D<unsigned char>	Opacity;
+	HostBuffer2D<ColorXYZf>		Radiance;
+	HostBuffer2D<int>			SampleCounts;
+	int							TileSize;
+	Vec2i						Offset;
+	int							NoEstimates;
+	int							SessionID;
+	quint32						Epoch;
+	bool						Raw;
 	QGpuJpegEncoder				GpuJpegEncoder;
 	QGpuJpegDecoder				GpuJpegDecoder;
 };
\ No newline at end of file
@@ -0,0 +1,391 @@
+
+#include "voxelcodec.h"
+
+#include <QVector>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QtConcurrentMap>
+#include <QtEndian>
+
+#include <emmintrin.h>
+#include <string.h>
+
+// Magic, number of bytes, brick size and number of bricks, followed by the encoded size of every brick
+static const quint32 Magic		= 0x43565245;
+static const int HeaderSize		= 20;
+
+struct QVoxelBrick
+{
+	QVoxelBrick() :
+		Voxels(0),
+		NoVoxels(0),
+		Encoded(0),
+		NoEncodedBytes(0),
+		Decoded(false)
+	{
+	}
+
+	short*					Voxels;
+	int						NoVoxels;
+	unsigned char*			Encoded;
+	int						NoEncodedBytes;
+	bool					Decoded;
+};
+
+struct QEncodeBrick
+{
+	typedef void result_type;
+
+	void operator()(QVoxelBrick& Brick) const
+	{
+		Brick.NoEncodedBytes = QVoxelCodec::Encode(Brick.Voxels, Brick.NoVoxels, Brick.Encoded);
+	}
+};
+
+struct QDecodeBrick
+{
+	typedef void result_type;
+
+	void operator()(QVoxelBrick& Brick) const
+	{
+		Brick.Decoded = QVoxelCodec::Decode(Brick.Encoded, Brick.NoEncodedBytes, Brick.Voxels, Brick.NoVoxels);
+	}
+};
+
+QVoxelCodec::QVoxelCodec(QObject* Parent /*= 0*/) :
+	QObject(Parent)
+{
+}
+
+int QVoxelCodec::GetMaxEncodedSize(const int& NoVoxels)
+{
+	// A width byte per block and at most sixteen bits per voxel
+	return (NoVoxels + BlockSize - 1) / BlockSize + NoVoxels * 2;
+}
+
+int QVoxelCodec::Encode(const short* Voxels, const int& NoVoxels, unsigned char* Output)
+{
+	unsigned char* Out = Output;
+
+	unsigned short Residuals[BlockSize];
+
+	short Previous = 0;
+
+	for (int First = 0; First < NoVoxels; First += BlockSize)
+	{
+		const int NoBlockVoxels = NoVoxels - First < BlockSize ? NoVoxels - First : BlockSize;
+
+		const short* Block = Voxels + First;
+
+		int i = 0;
+
+		__m128i Bits = _mm_setzero_si128();
+
+		// Eight residuals at a time, the differences wrap around so every residual fits in sixteen bits
+		if (NoBlockVoxels == BlockSize)
+		{
+			Residuals[0] = (unsigned short)(Block[0] - Previous);
+			Residuals[0] = (unsigned short)((Residuals[0] << 1) ^ (unsigned short)((short)Residuals[0] >> 15));
+
+			Bits = _mm_cvtsi32_si128(Residuals[0]);
+
+			for (i = 1; i + 8 <= BlockSize; i += 8)
+			{
+				const __m128i Current		= _mm_loadu_si128((const __m128i*)(Block + i));
+				const __m128i Predicted		= _mm_loadu_si128((const __m128i*)(Block + i - 1));
+				const __m128i Residual		= _mm_sub_epi16(Current, Predicted);
+				const __m128i ZigZag		= _mm_xor_si128(_mm_slli_epi16(Residual, 1), _mm_srai_epi16(Residual, 15));
+
+				_mm_storeu_si128((__m128i*)(Residuals + i), ZigZag);
+
+				Bits = _mm_or_si128(Bits, ZigZag);
+			}
+		}
+
+		unsigned short Scalar[8];
+
+		_mm_storeu_si128((__m128i*)Scalar, Bits);
+
+		unsigned int Mask = 0;
+
+		for (int k = 0; k < 8; k++)
+			Mask |= Scalar[k];
+
+		for (; i < NoBlockVoxels; i++)
+		{
+			const unsigned short Residual = (unsigned short)(Block[i] - (i == 0 ? Previous : Block[i - 1]));
+
+			Residuals[i] = (unsigned short)((Residual << 1) ^ (unsigned short)((short)Residual >> 15));
+
+			Mask |= Residuals[i];
+		}
+
+		Previous = Block[NoBlockVoxels - 1];
+
+		int Width = 0;
+
+		while (Mask >> Width)
+			Width++;
+
+		*Out++ = (unsigned char)Width;
+
+		if (Width == 0)
+			continue;
+
+		// Residuals are packed little endian, the accumulator is flushed a word at a time
+		unsigned long long Accumulator = 0;
+		int NoBits = 0;
+
+		for (int v = 0; v < NoBlockVoxels; v++)
+		{
+			Accumulator |= (unsigned long long)Residuals[v] << NoBits;
+			NoBits += Width;
+
+			if (NoBits >= 32)
+			{
+				const unsigned int Word = (unsigned int)Accumulator;
+
+				memcpy(Out, &Word, 4);
+
+				Out += 4;
+				Accumulator >>= 32;
+				NoBits -= 32;
+			}
+		}
+
+		for (; NoBits > 0; NoBits -= 8)
+		{
+			*Out++ = (unsigned char)Accumulator;
+
+			Accumulator >>= 8;
+		}
+	}
+
+	return (int)(Out - Output);
+}
+
+bool QVoxelCodec::Decode(const unsigned char* Input, const int& NoBytes, short* Voxels, const int& NoVoxels)
+{
+	const unsigned char* In		= Input;
+	const unsigned char* End	= Input + NoBytes;
+
+	unsigned short Residuals[BlockSize];
+
+	short Previous = 0;
+
+	for (int First = 0; First < NoVoxels; First += BlockSize)
+	{
+		const int NoBlockVoxels = NoVoxels - First < BlockSize ? NoVoxels - First : BlockSize;
+
+		if (In >= End)
+			return false;
+
+		const int Width = *In++;
+
+		if (Width > 16)
+			return false;
+
+		short* Block = Voxels + First;
+
+		// Air and constant regions carry no residuals at all
+		if (Width == 0)
+		{
+			for (int v = 0; v < NoBlockVoxels; v++)
+				Block[v] = Previous;
+
+			continue;
+		}
+
+		const int NoBlockBytes = (NoBlockVoxels * Width + 7) / 8;
+
+		if (End - In < NoBlockBytes)
+			return false;
+
+		const unsigned int Mask = (1u << Width) - 1;
+
+		// A residual never straddles more than three bytes, so it is read with a single unaligned load wherever there are bytes to spare behind the block
+		if (End - In >= NoBlockBytes + 3)
+		{
+			for (int v = 0, Bit = 0; v < NoBlockVoxels; v++, Bit += Width)
+			{
+				unsigned int Word;
+
+				memcpy(&Word, In + (Bit >> 3), 4);
+
+				Residuals[v] = (unsigned short)((Word >> (Bit & 7)) & Mask);
+			}
+		}
+		else
+		{
+			unsigned long long Accumulator = 0;
+			int NoBits = 0;
+
+			const unsigned char* Byte = In;
+
+			for (int v = 0; v < NoBlockVoxels; v++)
+			{
+				while (NoBits < Width)
+				{
+					Accumulator |= (unsigned long long)*Byte++ << NoBits;
+					NoBits += 8;
+				}
+
+				Residuals[v] = (unsigned short)(Accumulator & Mask);
+
+				Accumulator >>= Width;
+				NoBits -= Width;
+			}
+		}
+
+		In += NoBlockBytes;
+
+		int i = 0;
+
+		// The residuals are unzigzagged and the prediction is undone with a prefix sum over eight voxels at a time, carried over from the previous eight
+		const __m128i One	= _mm_set1_epi16(1);
+		const __m128i Zero	= _mm_setzero_si128();
+
+		__m128i Carry = _mm_set1_epi16(Previous);
+
+		for (; i + 8 <= NoBlockVoxels; i += 8)
+		{
+			const __m128i ZigZag = _mm_loadu_si128((const __m128i*)(Residuals + i));
+
+			__m128i Sum = _mm_xor_si128(_mm_srli_epi16(ZigZag, 1), _mm_sub_epi16(Zero, _mm_and_si128(ZigZag, One)));
+
+			Sum = _mm_add_epi16(Sum, _mm_slli_si128(Sum, 2));
+			Sum = _mm_add_epi16(Sum, _mm_slli_si128(Sum, 4));
+			Sum = _mm_add_epi16(Sum, _mm_slli_si128(Sum, 8));
+			Sum = _mm_add_epi16(Sum, Carry);
+
+			_mm_storeu_si128((__m128i*)(Block + i), Sum);
+
+			Carry = _mm_shufflehi_epi16(Sum, _MM_SHUFFLE(3, 3, 3, 3));
+			Carry = _mm_unpackhi_epi64(Carry, Carry);
+		}
+
+		short Value = i > 0 ? Block[i - 1] : Previous;
+
+		for (; i < NoBlockVoxels; i++)
+		{
+			const unsigned short ZigZag = Residuals[i];
+
+			Value = (short)(Value + (short)((ZigZag >> 1) ^ (unsigned short)-(short)(ZigZag & 1)));
+
+			Block[i] = Value;
+		}
+
+		Previous = Block[NoBlockVoxels - 1];
+	}
+
+	return In == End;
+}
+
+QByteArray QVoxelCodec::Compress(const QByteArray& Voxels, const int& BrickSize /*= 1024 * 1024*/)
+{
+	QElapsedTimer Timer;
+
+	Timer.start();
+
+	const int NoBrickVoxels	= qMax(BrickSize / 2, BlockSize);
+	const int NoVoxels		= Voxels.size() / 2;
+	const int NoBricks		= (NoVoxels + NoBrickVoxels - 1) / NoBrickVoxels;
+
+	// Every brick is encoded into its own worst case slot, the slots are closed up afterwards
+	const int NoSlotBytes = GetMaxEncodedSize(NoBrickVoxels);
+
+	QByteArray Slots;
+
+	Slots.resize(NoBricks * NoSlotBytes);
+
+	QVector<QVoxelBrick> Bricks(NoBricks);
+
+	for (int b = 0; b < NoBricks; b++)
+	{
+		Bricks[b].Voxels	= (short*)Voxels.constData() + b * NoBrickVoxels;
+		Bricks[b].NoVoxels	= qMin(NoBrickVoxels, NoVoxels - b * NoBrickVoxels);
+		Bricks[b].Encoded	= (unsigned char*)Slots.data() + b * NoSlotBytes;
+	}
+
+	QtConcurrent::blockingMap(Bricks, QEncodeBrick());
+
+	QByteArray Data;
+
+	Data.resize(HeaderSize + NoBricks * 4);
+
+	uchar* Header = (uchar*)Data.data();
+
+	qToLittleEndian<quint32>(Magic, Header);
+	qToLittleEndian<qint64>(Voxels.size(), Header + 4);
+	qToLittleEndian<quint32>(NoBrickVoxels, Header + 12);
+	qToLittleEndian<quint32>(NoBricks, Header + 16);
+
+	for (int b = 0; b < NoBricks; b++)
+		qToLittleEndian<quint32>(Bricks[b].NoEncodedBytes, Header + HeaderSize + b * 4);
+
+	for (int b = 0; b < NoBricks; b++)
+		Data.append((const char*)Bricks[b].Encoded, Bricks[b].NoEncodedBytes);
+
+	const float Time = (float)Timer.nsecsElapsed() / 1000000000.0f;
+
+	qDebug() << "Compressed" << Voxels.size() << "bytes of voxels to" << Data.size() << "bytes, ratio" << (float)Voxels.size() / (float)qMax(Data.size(), 1) << "at" << (Time > 0.0f ? (float)Voxels.size() / Time / 1e9f : 0.0f) << "GB/s";
+
+	return Data;
+}
+
+bool QVoxelCodec::Decompress(const QByteArray& Data, QByteArray& Voxels)
+{
+	QElapsedTimer Timer;
+
+	Timer.start();
+
+	const uchar* Header = (const uchar*)Data.constData();
+
+	if (Data.size() < HeaderSize || qFromLittleEndian<quint32>(Header) != Magic)
+		return false;
+
+	const qint64 NoBytes		= qFromLittleEndian<qint64>(Header + 4);
+	const int NoBrickVoxels		= (int)qFromLittleEndian<quint32>(Header + 12);
+	const int NoBricks			= (int)qFromLittleEndian<quint32>(Header + 16);
+
+	if (NoBytes < 0 || NoBytes > 0x7fffffff || NoBytes % 2 != 0 || NoBrickVoxels <= 0 || NoBricks != (NoBytes / 2 + NoBrickVoxels - 1) / NoBrickVoxels || Data.size() < HeaderSize + (qint64)NoBricks * 4)
+		return false;
+
+	const int NoVoxels = (int)(NoBytes / 2);
+
+	Voxels.resize((int)NoBytes);
+
+	QVector<QVoxelBrick> Bricks(NoBricks);
+
+	qint64 Offset = HeaderSize + NoBricks * 4;
+
+	for (int b = 0; b < NoBricks; b++)
+	{
+		Bricks[b].Voxels			= (short*)Voxels.data() + b * NoBrickVoxels;
+		Bricks[b].NoVoxels			= qMin(NoBrickVoxels, NoVoxels - b * NoBrickVoxels);
+		Bricks[b].Encoded			= (unsigned char*)Data.constData() + Offset;
+		Bricks[b].NoEncodedBytes	= (int)qFromLittleEndian<quint32>(Header + HeaderSize + b * 4);
+
+		Offset += Bricks[b].NoEncodedBytes;
+
+		if (Bricks[b].NoEncodedBytes < 0 || Offset > Data.size())
+			return false;
+	}
+
+	QtConcurrent::blockingMap(Bricks, QDecodeBrick());
+
+	for (int b = 0; b < NoBricks; b++)
+	{
+		if (!Bricks[b].Decoded)
+		{
+			Voxels.clear();
+			return false;
+		}
+	}
+
+	const float Time = (float)Timer.nsecsElapsed() / 1000000000.0f;
+
+	qDebug() << "Decompressed" << Data.size() << "bytes to" << NoBytes << "bytes of voxels at" << (Time > 0.0f ? (float)NoBytes / Time / 1e9f : 0.0f) << "GB/s";
+
+	return true;
+}
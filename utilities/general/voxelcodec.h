@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+
+/*! Lossless codec for 16 bit voxels
+	Every voxel is predicted by its predecessor, the zigzag encoded residuals of each block of voxels are bit-packed to the width of the largest one, so air and smooth tissue take a few bits per voxel
+	Whole volumes are compressed in independent bricks, which are encoded and decoded in parallel on the global thread pool
+*/
+class QVoxelCodec : public QObject
+{
+    Q_OBJECT
+
+public:
+	QVoxelCodec(QObject* Parent = 0);
+	virtual ~QVoxelCodec() {};
+
+	static int GetMaxEncodedSize(const int& NoVoxels);
+	static int Encode(const short* Voxels, const int& NoVoxels, unsigned char* Output);
+	static bool Decode(const unsigned char* Input, const int& NoBytes, short* Voxels, const int& NoVoxels);
+	static QByteArray Compress(const QByteArray& Voxels, const int& BrickSize = 1024 * 1024);
+	static bool Decompress(const QByteArray& Data, QByteArray& Voxels);
+
+	static const int BlockSize = 128;
+};
@@ -24,12 +24,13 @@ void QBaseServer::Start()
 	this->OnStarted();
 }
 
-void QBaseServer::SendDataToAll(const QString& Action, QByteArray& Data)
+void QBaseServer::SendDataToAll(const Protocol::Opcode& Opcode, const QByteArray& Data)
 {
-	// qDebug() << this->Name << "send" << Action.lower() << "to all";
+	// Every connection queues the same shared payload, one frame fans out without being copied
+	// qDebug() << this->Name << "send" << Protocol::GetName(Opcode) << "to all";
 
 	for (int s = 0; s < this->Connections.size(); s++)
-		this->Connections[s]->SendData(Action, Data);
+		this->Connections[s]->SendData(Opcode, Data);
 }
 
 void QBaseServer::OnNewConnection(const int& SocketDescriptor)
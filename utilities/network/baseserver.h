@@ -14,7 +14,7 @@ public:
 
 	void Start();
 
-	void SendDataToAll(const QString& Action, QByteArray& Data);
+	void SendDataToAll(const Protocol::Opcode& Opcode, const QByteArray& Data);
 
 protected:
 	void incomingConnection(int SocketDescriptor)
@@ -1,14 +1,57 @@
 
 #include "basesocket.h"
 
-#include <QFile>
-#include <QApplication>
+#include <QDebug>
+#include <QHostInfo>
+#include <QCoreApplication>
+
+// Q_OS_WIN is only defined once a Qt header has been included
+#ifdef Q_OS_WIN
+	#include <winsock2.h>
+#else
+	#include <sys/uio.h>
+	#include <errno.h>
+#endif
+
+// Headers and payloads gathered into a single vectored write
+static const int MaxNoSendBuffers = 32;
+
+// Smaller payloads are as cheap over the socket as their position in the ring
+static const int MinSharedSize = 4096;
+
+// Rings created by this process, the key has to be unique on the host
+static int NoSharedRings = 0;
+
+static QString GetSharedRingKey()
+{
+	return QString("ExposureRender-%1-%2-%3").arg(QHostInfo::localHostName()).arg(QCoreApplication::applicationPid()).arg(++NoSharedRings);
+}
 
 QBaseSocket::QBaseSocket(QObject* Parent /*= 0*/) :
 	QTcpSocket(Parent),
-	BlockSize(0)
+	Header(),
+	HeaderReceived(false),
+	ReceiveBuffer(),
+	BulkBuffer(),
+	NoReceivedBytes(0),
+	NoBulkBytes(0),
+	NoReplacedMessages(0),
+	PartialChannel(-1),
+	SharedMemorySize(0),
+	OutboundRing(),
+	InboundRing(),
+	SharedSend(false)
 {
+	for (int c = 0; c < Protocol::NoChannels; c++)
+	{
+		this->NoReceivedMessages[c]	= 0;
+		this->NoSentMessages[c]		= 0;
+	}
+
 	connect(this, SIGNAL(readyRead()), this, SLOT(OnReadyRead()), Qt::DirectConnection);
+	connect(this, SIGNAL(bytesWritten(qint64)), this, SLOT(OnReadyWrite()));
+	connect(this, SIGNAL(connected()), this, SLOT(OnSocketConnected()));
+	connect(this, SIGNAL(disconnected()), this, SLOT(OnSocketDisconnected()));
 }
 
 QBaseSocket::~QBaseSocket()
@@ -17,91 +60,544 @@ QBaseSocket::~QBaseSocket()
 
 void QBaseSocket::OnReadyRead()
 {
-	QDataStream DataStream(this);
+	// Beyond this size a receive buffer is released after the message, a single volume upload should not pin its size for the lifetime of the connection
+	const int MaxRetainedSize = 16 * 1024 * 1024;
+
+	while (this->state() == QAbstractSocket::ConnectedState)
+	{
+		if (!this->HeaderReceived)
+		{
+			if (this->bytesAvailable() < Protocol::HeaderSize)
+				return;
+
+			uchar Bytes[Protocol::HeaderSize];
+
+			this->read((char*)Bytes, Protocol::HeaderSize);
+
+			if (!Protocol::ReadHeader(Bytes, this->Header))
+			{
+				qDebug() << "Invalid message header, closing connection";
+
+				this->abort();
+				return;
+			}
+
+			if (this->Header.Length > Protocol::GetMaxLength(this->Header))
+			{
+				qDebug() << Protocol::GetName((Protocol::Opcode)this->Header.Opcode) << "message of" << this->Header.Length << "bytes exceeds" << Protocol::GetMaxLength(this->Header) << "bytes, closing connection";
+
+				this->abort();
+				return;
+			}
+
+			const int Channel = this->Header.Flags & Protocol::BulkChannel ? Protocol::Bulk : Protocol::Control;
+
+			if (this->Header.Sequence != this->NoReceivedMessages[Channel])
+				qDebug() << "Expected message" << this->NoReceivedMessages[Channel] << "but received" << this->Header.Sequence;
+
+			this->NoReceivedMessages[Channel]	= this->Header.Sequence + 1;
+			this->HeaderReceived				= true;
+			this->NoReceivedBytes				= 0;
+
+			if (Channel == Protocol::Bulk)
+			{
+				if ((quint64)this->NoBulkBytes + this->Header.Length > Protocol::MaxLength)
+				{
+					qDebug() << "Bulk message too large, closing connection";
+
+					this->abort();
+					return;
+				}
+
+				if (this->BulkBuffer.size() < (int)(this->NoBulkBytes + this->Header.Length))
+					this->BulkBuffer.resize(this->NoBulkBytes + this->Header.Length);
+			}
+			else
+			{
+				if (this->ReceiveBuffer.size() < (int)this->Header.Length)
+					this->ReceiveBuffer.resize(this->Header.Length);
+			}
+		}
+
+		const bool Bulk = (this->Header.Flags & Protocol::BulkChannel) != 0;
+
+		// The payload is read as it arrives, fragments of a bulk message straight behind the previous ones, so the socket never buffers an entire volume as well
+		if (this->NoReceivedBytes < this->Header.Length)
+		{
+			char* Target = Bulk ? this->BulkBuffer.data() + this->NoBulkBytes : this->ReceiveBuffer.data();
+
+			const qint64 NoBytes = this->read(Target + this->NoReceivedBytes, this->Header.Length - this->NoReceivedBytes);
+
+			if (NoBytes <= 0)
+				return;
+
+			this->NoReceivedBytes += (quint32)NoBytes;
+
+			if (this->NoReceivedBytes < this->Header.Length)
+				return;
+		}
+
+		this->HeaderReceived = false;
+
+		if (Bulk)
+		{
+			this->NoBulkBytes += this->Header.Length;
+
+			if (this->Header.Flags & Protocol::MoreFragments)
+				continue;
+
+			const quint32 NoBytes = this->NoBulkBytes;
+
+			this->NoBulkBytes = 0;
+
+			QByteArray Payload = QByteArray::fromRawData(this->BulkBuffer.constData(), NoBytes);
+
+			this->OnReceiveData((Protocol::Opcode)this->Header.Opcode, Payload);
+
+			if (this->BulkBuffer.size() > MaxRetainedSize)
+				this->BulkBuffer.clear();
+
+			continue;
+		}
+
+		// A view on the receive buffer, handlers that keep the payload beyond this call take a deep copy
+		QByteArray Payload = QByteArray::fromRawData(this->ReceiveBuffer.constData(), this->Header.Length);
+
+		// Or a view on the shared memory ring of the peer, the region is handed back once the handler returns
+		const bool Shared = (this->Header.Flags & Protocol::Shared) != 0;
+
+		quint32 Position = 0, Length = 0;
+
+		if (Shared)
+		{
+			const uchar* Descriptor = (const uchar*)this->ReceiveBuffer.constData();
+
+			if (this->Header.Length == 8)
+			{
+				Position	= qFromLittleEndian<quint32>(Descriptor);
+				Length		= qFromLittleEndian<quint32>(Descriptor + 4);
+			}
+
+			if (this->Header.Length != 8 || !this->InboundRing.Read(Position, Length, Payload))
+			{
+				qDebug() << "Invalid shared memory payload, closing connection";
+
+				this->abort();
+				return;
+			}
+		}
+
+		if (this->Header.Opcode == Protocol::Transport)
+			this->OnTransport(Payload);
+		else
+			this->OnReceiveData((Protocol::Opcode)this->Header.Opcode, Payload);
+
+		if (Shared)
+			this->InboundRing.Release(Position + Length);
+
+		if (this->ReceiveBuffer.size() > MaxRetainedSize)
+			this->ReceiveBuffer.clear();
+	}
+}
+
+void QBaseSocket::OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& ByteArray)
+{
+	qDebug() << "Not implemented";
+}
 
-    DataStream.setVersion(QDataStream::Qt_4_0);
+void QBaseSocket::SendData(const Protocol::Opcode& Opcode, const QByteArray& Data, const quint16& Flags /*= 0*/)
+{
+	// qDebug() << "Sending" << Protocol::GetName(Opcode);
 
-	if (this->bytesAvailable() < this->BlockSize)
+	if (this->state() != QAbstractSocket::ConnectedState)
 		return;
 
-	while (this->bytesAvailable() >=sizeof(quint32))
+	QByteArray Payload		= Data;
+	quint16 MessageFlags	= Flags;
+
+	// Frames and volumes for a peer on the same host are copied into the shared ring once, the socket only carries their position, a full ring falls back to the socket
+	quint32 Position = 0;
+
+	if (this->SharedSend && Protocol::IsSharable(Opcode) && Data.size() >= MinSharedSize && this->OutboundRing.Write(Data, Position))
 	{
-		if (this->BlockSize == 0)
-			DataStream >> this->BlockSize;
+		Payload.resize(8);
+
+		qToLittleEndian<quint32>(Position, (uchar*)Payload.data());
+		qToLittleEndian<quint32>(Data.size(), (uchar*)Payload.data() + 4);
+
+		MessageFlags |= Protocol::Shared;
+	}
+
+	const Protocol::Channel Channel = MessageFlags & Protocol::Shared ? Protocol::Control : Protocol::GetChannel(Opcode);
+
+	Protocol::Header Header;
+
+	// A newer frame takes the place of one that has not started sending, so a slow peer is at most one frame behind rather than a queue full
+	if (Protocol::IsReplaceable(Opcode))
+	{
+		QQueue<QSendItem>& SendQueue = this->SendQueues[Protocol::Control];
+
+		for (int i = 0; i < SendQueue.size(); i++)
+		{
+			QSendItem& Item = SendQueue[i];
+
+			Protocol::ReadHeader(Item.Header, Header);
+
+			if (Item.Offset > 0 || Header.Opcode != Opcode)
+				continue;
 
-		if (this->bytesAvailable() < this->BlockSize)
+			// The peer releases ring regions in the order it receives them, so a region must not overtake one that is queued behind it
+			if ((MessageFlags | Header.Flags) & Protocol::Shared)
+			{
+				bool SharedBehind = false;
+
+				for (int j = i + 1; j < SendQueue.size(); j++)
+				{
+					Protocol::Header Behind;
+
+					Protocol::ReadHeader(SendQueue[j].Header, Behind);
+
+					if (Behind.Flags & Protocol::Shared)
+						SharedBehind = true;
+				}
+
+				if (SharedBehind)
+					break;
+			}
+
+			Header.Flags	= MessageFlags;
+			Header.Length	= Payload.size();
+
+			Protocol::WriteHeader(Header, Item.Header);
+
+			Item.Payload	= Payload;
+			Item.Size		= Payload.size();
+
+			this->NoReplacedMessages++;
 			return;
+		}
+	}
+
+	Header.Opcode = Opcode;
+
+	if (Channel == Protocol::Control)
+	{
+		Header.Flags	= MessageFlags;
+		Header.Length	= Payload.size();
+		Header.Sequence	= this->NoSentMessages[Protocol::Control]++;
+
+		this->Enqueue(Protocol::Control, Header, Payload, 0, Payload.size());
+	}
+	else
+	{
+		// Uploads are queued as fragments that all share the payload, control messages queued later go out in between
+		qint64 Begin = 0;
+
+		do
+		{
+			const qint64 Size = qMin((qint64)Protocol::FragmentSize, Data.size() - Begin);
+
+			Header.Flags	= Flags | Protocol::BulkChannel | (Begin + Size < Data.size() ? Protocol::MoreFragments : 0);
+			Header.Length	= Size;
+			Header.Sequence	= this->NoSentMessages[Protocol::Bulk]++;
+
+			this->Enqueue(Protocol::Bulk, Header, Data, Begin, Size);
+
+			Begin += Size;
+		}
+		while (Begin < Data.size());
+	}
+
+	this->Drain();
+}
 
-		QString Action;
+void QBaseSocket::Enqueue(const Protocol::Channel& Channel, const Protocol::Header& Header, const QByteArray& Data, const qint64& Begin, const qint64& Size)
+{
+	// The queue shares the payload with its owner, the owner detaches if it modifies the payload before it has been sent
+	QSendItem Item;
 
-		QByteArray ByteArray(this->BlockSize);
+	Protocol::WriteHeader(Header, Item.Header);
 
-		DataStream.readRawData(ByteArray.data(), this->BlockSize);
+	Item.Payload	= Data;
+	Item.Begin		= Begin;
+	Item.Size		= Size;
+	Item.Offset		= 0;
 
-		QDataStream ActionDataStream(&ByteArray, QIODevice::ReadOnly);
+	this->SendQueues[Channel].enqueue(Item);
+}
 
-		ActionDataStream >> Action;
+bool QBaseSocket::IsQueued(const Protocol::Opcode& Opcode) const
+{
+	Protocol::Header Header;
 
-		QByteArray ActionData = ActionDataStream.device()->readAll();
+	// Payloads in the shared ring are queued on the control channel whatever their type
+	for (int c = 0; c < Protocol::NoChannels; c++)
+	{
+		const QQueue<QSendItem>& SendQueue = this->SendQueues[c];
 
-		this->OnReceiveData(Action, ActionData);
+		for (int i = 0; i < SendQueue.size(); i++)
+		{
+			Protocol::ReadHeader(SendQueue[i].Header, Header);
 
-		this->BlockSize = 0;
+			if (Header.Opcode == Opcode)
+				return true;
+		}
 	}
+
+	return false;
 }
 
-void QBaseSocket::OnReceiveData(const QString& Action, QByteArray& ByteArray)
+qint64 QBaseSocket::GetNoQueuedBytes() const
 {
-	qDebug() << "Not implemented";
+	qint64 NoBytes = 0;
+
+	for (int c = 0; c < Protocol::NoChannels; c++)
+	{
+		for (int i = 0; i < this->SendQueues[c].size(); i++)
+			NoBytes += Protocol::HeaderSize + this->SendQueues[c][i].Size - this->SendQueues[c][i].Offset;
+	}
+
+	return NoBytes + this->bytesToWrite();
 }
 
-void QBaseSocket::SendData(const QString& Action, QByteArray& Data)
+void QBaseSocket::OnReadyWrite()
 {
-	// qDebug() << "Sending" << Action.lower();
+	this->Drain();
+}
 
-	QByteArray ByteArray;
+void QBaseSocket::OnSocketConnected()
+{
+	if (this->SharedMemorySize <= 0 || !this->IsLocalPeer())
+		return;
 
-	QDataStream DataStream(&ByteArray, QIODevice::WriteOnly);
-	DataStream.setVersion(QDataStream::Qt_4_0);
+	// The connecting side offers its ring first, the peer attaches to it and offers its own in return
+	const QString Key = GetSharedRingKey();
 
-	DataStream << quint32(0);
+	if (this->OutboundRing.Create(Key, this->SharedMemorySize))
+		this->SendTransport(false, Key);
+}
 
-	DataStream << Action;
+void QBaseSocket::OnSocketDisconnected()
+{
+	for (int c = 0; c < Protocol::NoChannels; c++)
+		this->SendQueues[c].clear();
 
-	ByteArray.append(Data);
+	this->PartialChannel = -1;
 
-	DataStream.device()->seek(0);
-		    
-	DataStream << (quint32)(ByteArray.size() - sizeof(quint32));
+	this->SharedSend = false;
 
-    this->write(ByteArray);
-	this->flush();
+	this->OutboundRing.Detach();
+	this->InboundRing.Detach();
 }
 
-void QBaseSocket::SaveResource(QByteArray& ByteArray)
+bool QBaseSocket::IsLocalPeer() const
 {
-	QDataStream DataStream(&ByteArray, QIODevice::ReadWrite);
+	const QHostAddress Peer = this->peerAddress();
+
+	return Peer == this->localAddress() || Peer == QHostAddress(QHostAddress::LocalHost) || Peer == QHostAddress(QHostAddress::LocalHostIPv6);
+}
+
+void QBaseSocket::OnTransport(QByteArray& Data)
+{
+	QDataStream DataStream(&Data, QIODevice::ReadOnly);
 	DataStream.setVersion(QDataStream::Qt_4_0);
 
-	QString FileName;
+	bool Accepted = false;
+	QString Key;
+
+	DataStream >> Accepted;
+	DataStream >> Key;
+
+	// The peer has attached to our ring, or could not, in which case the ring is of no use
+	if (Accepted && this->OutboundRing.IsAttached())
+	{
+		qDebug() << "Sending frames and volumes through shared memory" << this->OutboundRing.GetKey();
+
+		this->SharedSend = true;
+	}
+	else if (!Accepted)
+	{
+		this->OutboundRing.Detach();
+	}
+
+	if (Key.isEmpty())
+		return;
+
+	const bool Attached = this->SharedMemorySize > 0 && this->IsLocalPeer() && this->InboundRing.Attach(Key);
+
+	QString OwnKey;
+
+	if (Attached && !this->OutboundRing.IsAttached())
+	{
+		const QString NewKey = GetSharedRingKey();
+
+		if (this->OutboundRing.Create(NewKey, this->SharedMemorySize))
+			OwnKey = NewKey;
+	}
+
+	this->SendTransport(Attached, OwnKey);
+}
+
+void QBaseSocket::SendTransport(const bool& Accepted, const QString& Key)
+{
 	QByteArray Data;
 
-	DataStream >> FileName;
-	DataStream >> Data;
+	QDataStream DataStream(&Data, QIODevice::WriteOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	DataStream << Accepted;
+	DataStream << Key;
+
+	this->SendData(Protocol::Transport, Data);
+}
+
+void QBaseSocket::Drain()
+{
+	// A frame handed to the socket on a stall goes out first, its bytesWritten() signal resumes draining
+	if (this->bytesToWrite() > 0)
+		return;
+
+	// Headers and payloads of several queued frames go out in one vectored write, straight from the buffers of their owners
+	while (!this->SendQueues[Protocol::Control].isEmpty() || !this->SendQueues[Protocol::Bulk].isEmpty())
+	{
+		const char* Data[MaxNoSendBuffers];
+		qint64 Sizes[MaxNoSendBuffers];
+		int Channels[MaxNoSendBuffers];
+
+		int NoBuffers	= 0;
+		int NoItems		= 0;
+
+		// A frame that is partly on the wire is finished first, then control frames overtake the fragments of bulk messages
+		for (int p = -1; p < Protocol::NoChannels; p++)
+		{
+			const int Channel = p < 0 ? this->PartialChannel : p;
+
+			if (Channel < 0)
+				continue;
+
+			const QQueue<QSendItem>& SendQueue = this->SendQueues[Channel];
+
+			const int First = p < 0 || Channel != this->PartialChannel ? 0 : 1;
+			const int Last	= p < 0 ? qMin(1, SendQueue.size()) : SendQueue.size();
+
+			for (int i = First; i < Last && NoBuffers + 2 <= MaxNoSendBuffers; i++)
+			{
+				const QSendItem& Item = SendQueue[i];
+
+				if (Item.Offset < Protocol::HeaderSize)
+				{
+					Data[NoBuffers]		= (const char*)Item.Header + Item.Offset;
+					Sizes[NoBuffers]	= Protocol::HeaderSize - Item.Offset;
+					NoBuffers++;
+				}
+
+				const qint64 PayloadOffset = qMax(Item.Offset - Protocol::HeaderSize, (qint64)0);
 
-	qDebug() << "Saving resource" << FileName << Data.count() << "bytes";
+				if (PayloadOffset < Item.Size)
+				{
+					Data[NoBuffers]		= Item.Payload.constData() + Item.Begin + PayloadOffset;
+					Sizes[NoBuffers]	= Item.Size - PayloadOffset;
+					NoBuffers++;
+				}
 
-	QFile File(QApplication::applicationDirPath() + "//resources//" + FileName);
-	
-	if (File.open(QIODevice::WriteOnly))
+				Channels[NoItems++] = Channel;
+			}
+		}
+
+		const qint64 NoBytes = this->WriteVector(Data, Sizes, NoBuffers);
+
+		if (NoBytes < 0)
+		{
+			qDebug() << "Unable to send," << this->GetQueueDepth() << "frames dropped";
+
+			for (int c = 0; c < Protocol::NoChannels; c++)
+				this->SendQueues[c].clear();
+
+			this->PartialChannel = -1;
+			break;
+		}
+
+		// The send buffer of the operating system is full, the first frame is handed to the socket, which already watches the descriptor and writes it once there is room again
+		if (NoBytes == 0)
+		{
+			const QSendItem& Item = this->SendQueues[Channels[0]].head();
+
+			const qint64 PayloadOffset = qMax(Item.Offset - Protocol::HeaderSize, (qint64)0);
+
+			if (Item.Offset < Protocol::HeaderSize)
+				this->write((const char*)Item.Header + Item.Offset, Protocol::HeaderSize - Item.Offset);
+
+			if (PayloadOffset < Item.Size)
+				this->write(Item.Payload.constData() + Item.Begin + PayloadOffset, Item.Size - PayloadOffset);
+
+			this->SendQueues[Channels[0]].dequeue();
+
+			this->PartialChannel = -1;
+			return;
+		}
+
+		// The frames were gathered in wire order and each was the head of its queue once its predecessors are dequeued
+		qint64 NoRemainingBytes = NoBytes;
+
+		this->PartialChannel = -1;
+
+		for (int i = 0; i < NoItems && NoRemainingBytes > 0; i++)
+		{
+			QSendItem& Item = this->SendQueues[Channels[i]].head();
+
+			const qint64 NoLeft = Protocol::HeaderSize + Item.Size - Item.Offset;
+
+			if (NoRemainingBytes < NoLeft)
+			{
+				Item.Offset				+= NoRemainingBytes;
+				this->PartialChannel	= Channels[i];
+				break;
+			}
+
+			NoRemainingBytes -= NoLeft;
+
+			this->SendQueues[Channels[i]].dequeue();
+		}
+	}
+}
+
+qint64 QBaseSocket::WriteVector(const char** Data, const qint64* Sizes, const int& NoBuffers)
+{
+#ifdef Q_OS_WIN
+	WSABUF Buffers[MaxNoSendBuffers];
+
+	for (int b = 0; b < NoBuffers; b++)
 	{
-		File.write(Data);
-		File.close();
+		Buffers[b].buf = (char*)Data[b];
+		Buffers[b].len = (ULONG)Sizes[b];
+	}
+
+	DWORD NoBytes = 0;
 
-		qDebug() << "Saved" << File.fileName();
+	if (WSASend((SOCKET)this->socketDescriptor(), Buffers, NoBuffers, &NoBytes, 0, 0, 0) == SOCKET_ERROR)
+		return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+
+	return NoBytes;
+#else
+	iovec Buffers[MaxNoSendBuffers];
+
+	for (int b = 0; b < NoBuffers; b++)
+	{
+		Buffers[b].iov_base	= (void*)Data[b];
+		Buffers[b].iov_len	= (size_t)Sizes[b];
 	}
-	else
+
+	ssize_t NoBytes = 0;
+
+	do
 	{
-		qDebug() << "Unable to save" << File.fileName();
+		NoBytes = writev(this->socketDescriptor(), Buffers, NoBuffers);
 	}
+	while (NoBytes < 0 && errno == EINTR);
+
+	if (NoBytes < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+
+	return NoBytes;
+#endif
 }
\ No newline at end of file
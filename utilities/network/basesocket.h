@@ -1,7 +1,21 @@
 #pragma once
 
+#include "protocol.h"
+#include "sharedring.h"
+
 #include <QTcpSocket>
 #include <QDataStream>
+#include <QQueue>
+
+/*! A queued frame, the payload is shared with its owner rather than copied and the frame covers a range of it */
+struct QSendItem
+{
+	uchar		Header[Protocol::HeaderSize];
+	QByteArray	Payload;
+	qint64		Begin;
+	qint64		Size;
+	qint64		Offset;
+};
 
 class QBaseSocket : public QTcpSocket
 {
@@ -12,16 +26,46 @@ public:
 	virtual ~QBaseSocket();
 
 public:
-	virtual void OnReceiveData(const QString& Action, QByteArray& ByteArray);
+	virtual void OnReceiveData(const Protocol::Opcode& Opcode, QByteArray& ByteArray);
 	
-	void SendData(const QString& Action, QByteArray& ByteArray);
-
-protected:
-	void SaveResource(QByteArray& ByteArray);
+	void SendData(const Protocol::Opcode& Opcode, const QByteArray& ByteArray, const quint16& Flags = 0);
+	bool IsQueued(const Protocol::Opcode& Opcode) const;
+	int GetQueueDepth() const { return this->SendQueues[Protocol::Control].size() + this->SendQueues[Protocol::Bulk].size(); }
+	qint64 GetNoQueuedBytes() const;
+	quint32 GetNoReplacedMessages() const { return this->NoReplacedMessages; }
+	void SetSharedMemorySize(const int& Size) { this->SharedMemorySize = Size; }
+	bool IsSharedMemory() const { return this->SharedSend; }
 
 public slots:
 	void OnReadyRead();
 
+private slots:
+	void OnReadyWrite();
+	void OnSocketConnected();
+	void OnSocketDisconnected();
+
+private:
+	bool IsLocalPeer() const;
+	void OnTransport(QByteArray& Data);
+	void SendTransport(const bool& Accepted, const QString& Key);
+	void Enqueue(const Protocol::Channel& Channel, const Protocol::Header& Header, const QByteArray& Data, const qint64& Begin, const qint64& Size);
+	void Drain();
+	qint64 WriteVector(const char** Data, const qint64* Sizes, const int& NoBuffers);
+
 private:
-	quint32		BlockSize;
-};
\ No newline at end of file
+	Protocol::Header	Header;
+	bool				HeaderReceived;
+	QByteArray			ReceiveBuffer;
+	QByteArray			BulkBuffer;
+	quint32				NoReceivedBytes;
+	quint32				NoBulkBytes;
+	quint32				NoReceivedMessages[Protocol::NoChannels];
+	quint32				NoSentMessages[Protocol::NoChannels];
+	quint32				NoReplacedMessages;
+	QQueue<QSendItem>	SendQueues[Protocol::NoChannels];
+	int					PartialChannel;
+	int					SharedMemorySize;
+	QSharedRing			OutboundRing;
+	QSharedRing			InboundRing;
+	bool				SharedSend;
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QtEndian>
+
+/*! Wire protocol between gui, compositor and renderers
+	Every message is a fixed twelve byte header followed by the payload: opcode (16 bit), flags (16 bit), payload length (32 bit) and sequence number (32 bit), all little endian
+	Uploads travel on a separate bulk channel in fragments, interleaved with control messages, sequence numbers are counted per channel
+	Peers on the same host can negotiate a shared memory ring per direction, frame and volume payloads then travel through the ring and only their position goes over the socket
+*/
+namespace Protocol
+{
+	/*! Message types */
+	enum Opcode
+	{
+		Invalid = 0,
+		Volume,
+		Bitmap,
+		Camera,
+		Estimate,
+		Crop,
+		Brick,
+		Radiance,
+		Pause,
+		Priority,
+		RenderStats,
+		Session,
+		Resolution,
+		VolumeChunk,
+		VolumeAck,
+		Relay,
+		Transport,
+		NoOpcodes
+	};
+
+	/*! Logical channels multiplexed over a connection, control messages overtake the fragments of bulk uploads */
+	enum Channel
+	{
+		Control = 0,
+		Bulk,
+		NoChannels
+	};
+
+	/*! Framing flags, the frame belongs to the bulk channel and more fragments of the same message follow */
+	const quint16 BulkChannel		= 0x8000;
+	const quint16 MoreFragments		= 0x4000;
+
+	/*! The payload is the position and length of the actual payload in the shared memory ring of the sender */
+	const quint16 Shared			= 0x2000;
+
+	/*! Bulk messages are split into fragments of this size, which bounds how long a control message waits behind an upload */
+	const int FragmentSize			= 256 * 1024;
+
+	/*! Message header */
+	struct Header
+	{
+		quint16		Opcode;
+		quint16		Flags;
+		quint32		Length;
+		quint32		Sequence;
+	};
+
+	const int HeaderSize		= 12;
+	const quint32 MaxLength		= 0x7fffffff;
+
+	/*! Receive limits per message, so a header alone can not make the peer allocate gigabytes. Estimates carry entire frames, other control messages only state */
+	const quint32 MaxControlLength	= 1024 * 1024;
+	const quint32 MaxEstimateLength	= 256 * 1024 * 1024;
+
+	/*! Writes \a Header to \a Bytes
+		@param[in] Header Message header
+		@param[out] Bytes Twelve bytes of wire data
+	*/
+	inline void WriteHeader(const Header& Header, uchar* Bytes)
+	{
+		qToLittleEndian<quint16>(Header.Opcode, Bytes);
+		qToLittleEndian<quint16>(Header.Flags, Bytes + 2);
+		qToLittleEndian<quint32>(Header.Length, Bytes + 4);
+		qToLittleEndian<quint32>(Header.Sequence, Bytes + 8);
+	}
+
+	/*! Reads \a Header from \a Bytes
+		@param[in] Bytes Twelve bytes of wire data
+		@param[out] Header Message header
+		@return Whether the header is valid
+	*/
+	inline bool ReadHeader(const uchar* Bytes, Header& Header)
+	{
+		Header.Opcode	= qFromLittleEndian<quint16>(Bytes);
+		Header.Flags	= qFromLittleEndian<quint16>(Bytes + 2);
+		Header.Length	= qFromLittleEndian<quint32>(Bytes + 4);
+		Header.Sequence	= qFromLittleEndian<quint32>(Bytes + 8);
+
+		return Header.Opcode > Invalid && Header.Opcode < NoOpcodes && Header.Length <= MaxLength;
+	}
+
+	/*! Returns the largest payload a single frame of \a Header may carry, bulk messages are bounded per fragment
+		@param[in] Header Message header
+		@return Maximum payload length in bytes
+	*/
+	inline quint32 GetMaxLength(const Header& Header)
+	{
+		if (Header.Flags & BulkChannel)
+			return FragmentSize;
+
+		return Header.Opcode == Estimate ? MaxEstimateLength : MaxControlLength;
+	}
+
+	/*! Returns the channel messages of type \a Opcode are sent on
+		@param[in] Opcode Message type
+		@return Bulk for uploads, control otherwise
+	*/
+	inline Channel GetChannel(const Opcode& Opcode)
+	{
+		return Opcode == Volume || Opcode == VolumeChunk || Opcode == Brick || Opcode == Bitmap ? Bulk : Control;
+	}
+
+	/*! Returns whether a queued message of type \a Opcode may be replaced by a newer one before it is sent
+		Only state that is entirely superseded by its successor qualifies, control messages and uploads are never dropped
+		@param[in] Opcode Message type
+		@return Whether the latest message wins
+	*/
+	inline bool IsReplaceable(const Opcode& Opcode)
+	{
+		return Opcode == Estimate || Opcode == Priority || Opcode == RenderStats || Opcode == Camera;
+	}
+
+	/*! Returns whether the payload of messages of type \a Opcode travels through shared memory when the peer is on the same host
+		@param[in] Opcode Message type
+		@return Whether the payload is a frame or volume
+	*/
+	inline bool IsSharable(const Opcode& Opcode)
+	{
+		return Opcode == Estimate || Opcode == Volume || Opcode == VolumeChunk || Opcode == Brick || Opcode == Bitmap;
+	}
+
+	/*! Returns the name of \a Opcode, for logging
+		@param[in] Opcode Message type
+		@return Name
+	*/
+	inline const char* GetName(const Opcode& Opcode)
+	{
+		static const char* Names[] = { "invalid", "volume", "bitmap", "camera", "estimate", "crop", "brick", "radiance", "pause", "priority", "render stats", "session", "resolution", "volume chunk", "volume ack", "relay", "transport" };
+
+		return Opcode > Invalid && Opcode < NoOpcodes ? Names[Opcode] : Names[Invalid];
+	}
+}
@@ -0,0 +1,170 @@
+
+#include "resourcecache.h"
+#include "general\voxelcodec.h"
+
+#include <QFile>
+#include <QDebug>
+#include <QCryptographicHash>
+#include <QtConcurrentRun>
+
+static bool WriteResource(const QString& FileName, const QByteArray& Hash, const QByteArray& Data, const bool& Compress)
+{
+	// A corrupt resource must never be found under the hash of the intact one
+	if (QResourceCache::GetHash(Data) != Hash)
+	{
+		qDebug() << "Resource does not match its hash" << Hash.toHex() << ", not cached";
+		return false;
+	}
+
+	const QByteArray Contents = Compress ? QVoxelCodec::Compress(Data) : Data;
+
+	QFile File(FileName + ".part");
+
+	if (!File.open(QIODevice::WriteOnly) || File.write(Contents) != Contents.size())
+	{
+		qDebug() << "Unable to write" << File.fileName();
+
+		File.remove();
+		return false;
+	}
+
+	File.close();
+
+	QFile::remove(FileName);
+
+	return File.rename(FileName);
+}
+
+QResourceCache::QResourceCache(const QString& Directory, QObject* Parent /*= 0*/) :
+	QObject(Parent),
+	Directory(Directory),
+	PendingWrites()
+{
+}
+
+QResourceCache::~QResourceCache()
+{
+	for (int w = 0; w < this->PendingWrites.size(); w++)
+		this->PendingWrites[w].Future.waitForFinished();
+}
+
+QByteArray QResourceCache::GetHash(const QByteArray& Data)
+{
+	return QCryptographicHash::hash(Data, QCryptographicHash::Sha1);
+}
+
+QByteArray QResourceCache::GetHash(QIODevice* Device)
+{
+	QCryptographicHash Hash(QCryptographicHash::Sha1);
+
+	// The device is hashed a block at a time, a file is never read as a whole
+	QByteArray Block;
+
+	Block.resize(1024 * 1024);
+
+	Device->seek(0);
+
+	while (!Device->atEnd())
+	{
+		const qint64 NoBytes = Device->read(Block.data(), Block.size());
+
+		if (NoBytes <= 0)
+			break;
+
+		Hash.addData(Block.constData(), NoBytes);
+	}
+
+	Device->seek(0);
+
+	return Hash.result();
+}
+
+bool QResourceCache::Contains(const QByteArray& Hash)
+{
+	this->Collect();
+
+	for (int w = 0; w < this->PendingWrites.size(); w++)
+	{
+		if (this->PendingWrites[w].Hash == Hash)
+			return true;
+	}
+
+	return QFile::exists(this->GetFileName(Hash)) || QFile::exists(this->GetFileName(Hash, true));
+}
+
+bool QResourceCache::Load(const QByteArray& Hash, QByteArray& Data)
+{
+	this->Collect();
+
+	for (int w = 0; w < this->PendingWrites.size(); w++)
+	{
+		if (this->PendingWrites[w].Hash != Hash)
+			continue;
+
+		Data = this->PendingWrites[w].Data;
+		return true;
+	}
+
+	const bool Compressed = !QFile::exists(this->GetFileName(Hash)) && QFile::exists(this->GetFileName(Hash, true));
+
+	QFile File(this->GetFileName(Hash, Compressed));
+
+	if (!File.open(QIODevice::ReadOnly))
+		return false;
+
+	Data.resize(File.size());
+
+	if (File.read(Data.data(), Data.size()) != Data.size())
+	{
+		qDebug() << "Unable to read" << File.fileName();
+
+		Data.clear();
+		return false;
+	}
+
+	if (!Compressed)
+		return true;
+
+	QByteArray Voxels;
+
+	if (!QVoxelCodec::Decompress(Data, Voxels))
+	{
+		qDebug() << File.fileName() << "is not a compressed volume";
+
+		Data.clear();
+		return false;
+	}
+
+	Data = Voxels;
+
+	return true;
+}
+
+void QResourceCache::Store(const QByteArray& Hash, const QByteArray& Data, const bool& Compress /*= false*/)
+{
+	if (this->Contains(Hash))
+		return;
+
+	// The write shares the data with its owner, it is neither copied nor does it hold up the event loop
+	QPendingWrite PendingWrite;
+
+	PendingWrite.Hash	= Hash;
+	PendingWrite.Data	= Data;
+	PendingWrite.Future	= QtConcurrent::run(WriteResource, this->GetFileName(Hash, Compress), Hash, Data, Compress);
+
+	this->PendingWrites.append(PendingWrite);
+}
+
+QString QResourceCache::GetFileName(const QByteArray& Hash, const bool& Compressed /*= false*/) const
+{
+	return this->Directory + "//" + QString(Hash.toHex()) + (Compressed ? ".voxels" : "");
+}
+
+void QResourceCache::Collect()
+{
+	for (int w = this->PendingWrites.size() - 1; w >= 0; w--)
+	{
+		if (this->PendingWrites[w].Future.isFinished())
+			this->PendingWrites.removeAt(w);
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QIODevice>
+#include <QList>
+#include <QFuture>
+
+/*! A resource that is being written to disk, it is served from memory until the write has finished */
+struct QPendingWrite
+{
+	QByteArray		Hash;
+	QByteArray		Data;
+	QFuture<bool>	Future;
+};
+
+/*! Resources on disk, keyed by the hash of their content
+	Writes happen on the global thread pool, a resource only appears under its hash once it has been written and verified completely
+	Voxels can be stored compressed, they are still keyed by the hash of the decoded voxels and decoded transparently when loaded
+*/
+class QResourceCache : public QObject
+{
+    Q_OBJECT
+
+public:
+	QResourceCache(const QString& Directory, QObject* Parent = 0);
+	virtual ~QResourceCache();
+
+	static QByteArray GetHash(const QByteArray& Data);
+	static QByteArray GetHash(QIODevice* Device);
+
+	bool Contains(const QByteArray& Hash);
+	bool Load(const QByteArray& Hash, QByteArray& Data);
+	void Store(const QByteArray& Hash, const QByteArray& Data, const bool& Compress = false);
+
+private:
+	QString GetFileName(const QByteArray& Hash, const bool& Compressed = false) const;
+	void Collect();
+
+private:
+	QString					Directory;
+	QList<QPendingWrite>	PendingWrites;
+};
@@ -0,0 +1,43 @@
+
+#include "sendbufferpool.h"
+
+QSendBufferPool::QSendBufferPool(const int& MaxNoBuffers /*= 4*/, QObject* Parent /*= 0*/) :
+	QObject(Parent),
+	Mutex(),
+	Buffers(),
+	MaxNoBuffers(MaxNoBuffers)
+{
+}
+
+QByteArray QSendBufferPool::Acquire()
+{
+	QMutexLocker Locker(&this->Mutex);
+
+	QByteArray Buffer;
+
+	// Only a buffer that no send queue refers to anymore can be written to without detaching
+	for (int b = 0; b < this->Buffers.size(); b++)
+	{
+		if (!this->Buffers[b].isDetached())
+			continue;
+
+		Buffer = this->Buffers.takeAt(b);
+		break;
+	}
+
+	// A reserved capacity survives truncation, so the buffer is only reallocated when a message outgrows it
+	Buffer.reserve(Buffer.capacity());
+	Buffer.resize(0);
+
+	return Buffer;
+}
+
+void QSendBufferPool::Release(const QByteArray& Buffer)
+{
+	QMutexLocker Locker(&this->Mutex);
+
+	if (Buffer.capacity() == 0 || this->Buffers.size() >= this->MaxNoBuffers)
+		return;
+
+	this->Buffers.append(Buffer);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+
+/*! Reusable buffers for messages that are assembled every frame
+	A released buffer is shared with the send queues of the sockets it was sent to, it is handed out again once they are done with it
+*/
+class QSendBufferPool : public QObject
+{
+    Q_OBJECT
+
+public:
+	QSendBufferPool(const int& MaxNoBuffers = 4, QObject* Parent = 0);
+	virtual ~QSendBufferPool() {};
+
+	QByteArray Acquire();
+	void Release(const QByteArray& Buffer);
+
+private:
+	QMutex				Mutex;
+	QList<QByteArray>	Buffers;
+	int					MaxNoBuffers;
+};
@@ -0,0 +1,137 @@
+
+#include "sharedring.h"
+
+#include <QAtomicInt>
+#include <QDebug>
+
+/*! Start of the segment, followed by the payloads */
+struct QSharedRingHeader
+{
+	quint32			Magic;
+	quint32			Capacity;
+	QBasicAtomicInt	Tail;
+};
+
+static const quint32 Magic		= 0x47525245;
+static const int HeaderSize		= 64;
+
+QSharedRing::QSharedRing(QObject* Parent /*= 0*/) :
+	QObject(Parent),
+	SharedMemory(),
+	Capacity(0),
+	Head(0)
+{
+}
+
+bool QSharedRing::Create(const QString& Key, const int& Capacity)
+{
+	this->Detach();
+
+	// Positions are free running counters, a power of two capacity keeps them consistent when they wrap around
+	quint32 PowerOfTwo = 1024 * 1024;
+
+	while (PowerOfTwo < (quint32)Capacity && PowerOfTwo < 0x40000000)
+		PowerOfTwo *= 2;
+
+	this->SharedMemory.setKey(Key);
+
+	if (!this->SharedMemory.create(HeaderSize + PowerOfTwo))
+	{
+		qDebug() << "Unable to create shared memory" << Key << ":" << this->SharedMemory.errorString();
+		return false;
+	}
+
+	QSharedRingHeader* Header = (QSharedRingHeader*)this->SharedMemory.data();
+
+	Header->Magic		= Magic;
+	Header->Capacity	= PowerOfTwo;
+	Header->Tail.fetchAndStoreOrdered(0);
+
+	this->Capacity	= PowerOfTwo;
+	this->Head		= 0;
+
+	return true;
+}
+
+bool QSharedRing::Attach(const QString& Key)
+{
+	this->Detach();
+
+	this->SharedMemory.setKey(Key);
+
+	if (!this->SharedMemory.attach())
+		return false;
+
+	const QSharedRingHeader* Header = (const QSharedRingHeader*)this->SharedMemory.constData();
+
+	if (this->SharedMemory.size() < HeaderSize || Header->Magic != Magic || (qint64)Header->Capacity + HeaderSize > this->SharedMemory.size())
+	{
+		qDebug() << "Shared memory" << Key << "is not a ring buffer";
+
+		this->Detach();
+		return false;
+	}
+
+	this->Capacity	= Header->Capacity;
+	this->Head		= 0;
+
+	return true;
+}
+
+void QSharedRing::Detach()
+{
+	if (this->SharedMemory.isAttached())
+		this->SharedMemory.detach();
+
+	this->Capacity	= 0;
+	this->Head		= 0;
+}
+
+bool QSharedRing::Write(const QByteArray& Data, quint32& Position)
+{
+	if (!this->IsAttached() || (quint32)Data.size() > this->Capacity)
+		return false;
+
+	QSharedRingHeader* Header = (QSharedRingHeader*)this->SharedMemory.data();
+
+	const quint32 Tail		= (quint32)Header->Tail.fetchAndAddOrdered(0);
+	const quint32 Offset	= this->Head & (this->Capacity - 1);
+	const quint32 Length	= Data.size();
+
+	// A payload never wraps around, the end of the ring is skipped instead
+	const quint32 Padding = Offset + Length > this->Capacity ? this->Capacity - Offset : 0;
+
+	if (this->Head - Tail + Padding + Length > this->Capacity)
+		return false;
+
+	Position = this->Head + Padding;
+
+	memcpy((char*)this->SharedMemory.data() + HeaderSize + (Position & (this->Capacity - 1)), Data.constData(), Length);
+
+	this->Head = Position + Length;
+
+	return true;
+}
+
+bool QSharedRing::Read(const quint32& Position, const quint32& Length, QByteArray& Data)
+{
+	const quint32 Offset = Position & (this->Capacity - 1);
+
+	if (!this->IsAttached() || Length > this->Capacity || Offset + Length > this->Capacity)
+		return false;
+
+	// A view on the segment, it stays valid until the region is released
+	Data = QByteArray::fromRawData((const char*)this->SharedMemory.constData() + HeaderSize + Offset, Length);
+
+	return true;
+}
+
+void QSharedRing::Release(const quint32& Position)
+{
+	if (!this->IsAttached())
+		return;
+
+	QSharedRingHeader* Header = (QSharedRingHeader*)this->SharedMemory.data();
+
+	Header->Tail.fetchAndStoreOrdered((int)Position);
+}
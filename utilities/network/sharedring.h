@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QSharedMemory>
+
+/*! Ring buffer in shared memory that carries message payloads to a peer on the same host
+	The producer copies a payload in and sends its position over the socket, the consumer hands out a view on it and publishes how far it has read, so neither side ever waits for the other
+*/
+class QSharedRing : public QObject
+{
+    Q_OBJECT
+
+public:
+	QSharedRing(QObject* Parent = 0);
+	virtual ~QSharedRing() {};
+
+	bool Create(const QString& Key, const int& Capacity);
+	bool Attach(const QString& Key);
+	void Detach();
+	bool IsAttached() const { return this->SharedMemory.isAttached(); }
+	QString GetKey() const { return this->SharedMemory.key(); }
+	bool Write(const QByteArray& Data, quint32& Position);
+	bool Read(const quint32& Position, const quint32& Length, QByteArray& Data);
+	void Release(const quint32& Position);
+
+private:
+	QSharedMemory	SharedMemory;
+	quint32			Capacity;
+	quint32			Head;
+};
@@ -0,0 +1,430 @@
+
+#include "volumetransfer.h"
+#include "general\voxelcodec.h"
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QVector>
+#include <QtEndian>
+#include <QtConcurrentMap>
+
+// Identifier, index and checksum in front of the voxels of every chunk
+static const int ChunkPrefixSize = 10;
+
+// The most recent transfer that was interrupted before it completed, the next receiver that is offered the same volume resumes it
+static QVolumeInfo	InterruptedInfo;
+static QByteArray	InterruptedVoxels;
+static int			NoInterruptedChunks = 0;
+
+struct QVolumeChunk
+{
+	typedef void result_type;
+
+	void operator()(QVolumeChunk& Chunk) const
+	{
+		Chunk.Data.resize(ChunkPrefixSize + QVoxelCodec::GetMaxEncodedSize(Chunk.Voxels.size() / 2));
+
+		const int NoBytes = QVoxelCodec::Encode((const short*)Chunk.Voxels.constData(), Chunk.Voxels.size() / 2, (unsigned char*)Chunk.Data.data() + ChunkPrefixSize);
+
+		Chunk.Data.resize(ChunkPrefixSize + NoBytes);
+	}
+
+	int			Index;
+	QByteArray	Voxels;
+	QByteArray	Data;
+};
+
+QVolumeInfo::QVolumeInfo() :
+	ID(0),
+	Hash(),
+	FileName(),
+	Resolution(0, 0, 0),
+	Spacing(1.0f),
+	NoBytes(0),
+	ChunkSize(1024 * 1024),
+	Compressed(false)
+{
+}
+
+int QVolumeInfo::GetNoChunks() const
+{
+	return this->ChunkSize > 0 ? (int)((this->NoBytes + this->ChunkSize - 1) / this->ChunkSize) : 0;
+}
+
+qint64 QVolumeInfo::GetChunkSize(const int& Index) const
+{
+	return qMin((qint64)this->ChunkSize, this->NoBytes - (qint64)Index * this->ChunkSize);
+}
+
+QVolumeSender::QVolumeSender(QBaseSocket* Socket, const int& NoChunksInFlight /*= 4*/, QObject* Parent /*= 0*/) :
+	QObject(Parent),
+	Socket(Socket),
+	Info(),
+	Source(0),
+	NoChunksInFlight(NoChunksInFlight),
+	NoAvailableChunks(0),
+	NextChunk(0),
+	NoAcknowledgedChunks(0),
+	Acknowledged(false),
+	Compress(false),
+	NoEncodedBytes(0),
+	NoDecodedBytes(0)
+{
+}
+
+void QVolumeSender::Start(const QVolumeInfo& Info, QIODevice* Source)
+{
+	this->Stop();
+
+	this->Info				= Info;
+	this->Source			= Source;
+	this->NoAvailableChunks	= Info.GetNoChunks();
+
+	this->Source->setParent(this);
+
+	this->Resume();
+}
+
+void QVolumeSender::Start(const QVolumeInfo& Info, const QByteArray& Voxels)
+{
+	// The buffer shares the voxels with their owner rather than copying them
+	QBuffer* Buffer = new QBuffer();
+
+	Buffer->setData(Voxels);
+	Buffer->open(QIODevice::ReadOnly);
+
+	this->Start(Info, Buffer);
+}
+
+void QVolumeSender::Resume()
+{
+	if (!this->Source)
+		return;
+
+	// Chunks only follow once the receiver has told where to start, which is where it left off if it has seen this volume before
+	this->NextChunk				= 0;
+	this->NoAcknowledgedChunks	= 0;
+	this->Acknowledged			= false;
+	this->NoEncodedBytes		= 0;
+	this->NoDecodedBytes		= 0;
+
+	// Chunks for a peer on the same host go through shared memory, encoding them would only cost time
+	this->Compress = this->Info.Compressed && !this->Socket->IsSharedMemory();
+
+	QByteArray Data;
+
+	QDataStream DataStream(&Data, QIODevice::WriteOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	DataStream << this->Info.ID;
+	DataStream << this->Info.Hash;
+	DataStream << this->Info.FileName;
+
+	for (int i = 0; i < 3; i++)
+		DataStream << this->Info.Resolution[i];
+
+	for (int i = 0; i < 3; i++)
+		DataStream << this->Info.Spacing[i];
+
+	DataStream << this->Info.NoBytes;
+	DataStream << this->Info.ChunkSize;
+	DataStream << this->Compress;
+
+	this->Socket->SendData(Protocol::Volume, Data);
+}
+
+void QVolumeSender::Stop()
+{
+	delete this->Source;
+
+	this->Source = 0;
+}
+
+void QVolumeSender::SetNoAvailableChunks(const int& NoAvailableChunks)
+{
+	// A relay forwards the chunks it has received so far, the rest follow as they arrive
+	this->NoAvailableChunks = NoAvailableChunks;
+
+	if (this->Source && this->Acknowledged)
+		this->SendChunks();
+}
+
+void QVolumeSender::OnAcknowledge(QByteArray& Data)
+{
+	QDataStream DataStream(&Data, QIODevice::ReadOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	quint32 ID = 0;
+	int NoChunks = 0;
+	bool Retransmit = false;
+
+	DataStream >> ID;
+	DataStream >> NoChunks;
+	DataStream >> Retransmit;
+
+	if (!this->Source || ID != this->Info.ID)
+		return;
+
+	this->NoAcknowledgedChunks	= NoChunks;
+	this->Acknowledged			= true;
+
+	// A corrupt chunk and everything after it is sent again, the receiver ignores the chunks that were already under way
+	this->NextChunk = Retransmit ? NoChunks : qMax(this->NextChunk, NoChunks);
+
+	if (this->NoAcknowledgedChunks >= this->Info.GetNoChunks())
+	{
+		qDebug() << "Sent volume" << this->Info.FileName << this->Info.NoBytes << "bytes";
+
+		if (this->Compress && this->NoEncodedBytes > 0)
+			qDebug() << "Compressed" << this->NoDecodedBytes << "bytes of chunks to" << this->NoEncodedBytes << "bytes, ratio" << (float)this->NoDecodedBytes / (float)this->NoEncodedBytes;
+
+		this->Stop();
+
+		emit Finished();
+		return;
+	}
+
+	this->SendChunks();
+}
+
+bool QVolumeSender::IsBusy() const
+{
+	return this->Source != 0;
+}
+
+void QVolumeSender::SendChunks()
+{
+	const int NoChunks = this->Info.GetNoChunks();
+
+	// Only a window of chunks is read and queued at a time, so neither end ever holds more than a few chunks of the file
+	QVector<QVolumeChunk> Chunks;
+
+	while (this->NextChunk < qMin(NoChunks, this->NoAvailableChunks) && this->NextChunk < this->NoAcknowledgedChunks + this->NoChunksInFlight)
+	{
+		const qint64 Size = this->Info.GetChunkSize(this->NextChunk);
+
+		QVolumeChunk Chunk;
+
+		Chunk.Index = this->NextChunk;
+
+		QByteArray& Raw = this->Compress ? Chunk.Voxels : Chunk.Data;
+
+		Raw.resize(this->Compress ? Size : ChunkPrefixSize + Size);
+
+		char* Voxels = Raw.data() + (this->Compress ? 0 : ChunkPrefixSize);
+
+		if (!this->Source->seek((qint64)this->NextChunk * this->Info.ChunkSize) || this->Source->read(Voxels, Size) != Size)
+		{
+			qDebug() << "Unable to read chunk" << this->NextChunk << "of" << this->Info.FileName;
+
+			this->Stop();
+			return;
+		}
+
+		Chunks.append(Chunk);
+
+		this->NextChunk++;
+	}
+
+	// The chunks of the window are encoded in parallel, the device itself is only read from this thread
+	if (this->Compress)
+		QtConcurrent::blockingMap(Chunks, QVolumeChunk());
+
+	for (int c = 0; c < Chunks.size(); c++)
+	{
+		QByteArray& Data = Chunks[c].Data;
+
+		uchar* Prefix		= (uchar*)Data.data();
+		const char* Payload	= Data.constData() + ChunkPrefixSize;
+		const int Size		= Data.size() - ChunkPrefixSize;
+
+		qToLittleEndian<quint32>(this->Info.ID, Prefix);
+		qToLittleEndian<quint32>(Chunks[c].Index, Prefix + 4);
+		qToLittleEndian<quint16>(qChecksum(Payload, Size), Prefix + 8);
+
+		this->NoEncodedBytes += Size;
+		this->NoDecodedBytes += this->Info.GetChunkSize(Chunks[c].Index);
+
+		this->Socket->SendData(Protocol::VolumeChunk, Data);
+	}
+}
+
+QVolumeReceiver::QVolumeReceiver(QBaseSocket* Socket, QResourceCache* ResourceCache /*= 0*/, QObject* Parent /*= 0*/) :
+	QObject(Parent),
+	Socket(Socket),
+	ResourceCache(ResourceCache),
+	Info(),
+	Voxels(),
+	NoChunks(0)
+{
+}
+
+QVolumeReceiver::~QVolumeReceiver()
+{
+	if (this->NoChunks == 0 || this->IsComplete())
+		return;
+
+	InterruptedInfo		= this->Info;
+	InterruptedVoxels	= this->Voxels;
+	NoInterruptedChunks	= this->NoChunks;
+}
+
+bool QVolumeReceiver::OnHeader(QByteArray& Data)
+{
+	QDataStream DataStream(&Data, QIODevice::ReadOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	QVolumeInfo Info;
+
+	DataStream >> Info.ID;
+	DataStream >> Info.Hash;
+	DataStream >> Info.FileName;
+
+	for (int i = 0; i < 3; i++)
+		DataStream >> Info.Resolution[i];
+
+	for (int i = 0; i < 3; i++)
+		DataStream >> Info.Spacing[i];
+
+	DataStream >> Info.NoBytes;
+	DataStream >> Info.ChunkSize;
+	DataStream >> Info.Compressed;
+
+	// Compressed chunks have to hold whole voxels
+	if (Info.ChunkSize <= 0 || (Info.Compressed && Info.ChunkSize % 2 != 0) || Info.NoBytes != (qint64)Info.Resolution.CumulativeProduct() * (qint64)sizeof(short) || Info.NoBytes > Protocol::MaxLength)
+	{
+		qDebug() << "Volume" << Info.FileName << "does not match its resolution";
+		return false;
+	}
+
+	// A volume that has been seen before is loaded from the cache, acknowledging every chunk tells the sender there is nothing to send
+	QByteArray Voxels;
+
+	if (this->ResourceCache && !Info.Hash.isEmpty() && this->ResourceCache->Load(Info.Hash, Voxels) && Voxels.size() == Info.NoBytes)
+	{
+		qDebug() << "Volume" << Info.FileName << "is cached";
+
+		this->Info		= Info;
+		this->Voxels	= Voxels;
+		this->NoChunks	= Info.GetNoChunks();
+
+		this->Acknowledge(false);
+
+		return true;
+	}
+
+	const bool Resume = Info.ID == this->Info.ID && this->Voxels.size() == Info.NoBytes && !this->IsComplete();
+
+	if (!Resume)
+	{
+		if (Info.ID == InterruptedInfo.ID && InterruptedVoxels.size() == Info.NoBytes)
+		{
+			this->Voxels	= InterruptedVoxels;
+			this->NoChunks	= NoInterruptedChunks;
+
+			InterruptedInfo		= QVolumeInfo();
+			InterruptedVoxels	= QByteArray();
+			NoInterruptedChunks	= 0;
+		}
+		else
+		{
+			// The chunks are written into this buffer directly, it is the only copy of the volume on this end
+			this->Voxels	= QByteArray();
+			this->NoChunks	= 0;
+
+			this->Voxels.resize(Info.NoBytes);
+		}
+	}
+
+	this->Info = Info;
+
+	if (this->NoChunks > 0)
+		qDebug() << "Resuming volume" << this->Info.FileName << "at chunk" << this->NoChunks << "of" << this->Info.GetNoChunks();
+
+	this->Acknowledge(false);
+
+	return false;
+}
+
+bool QVolumeReceiver::OnChunk(QByteArray& Data)
+{
+	if (Data.size() < ChunkPrefixSize || this->Voxels.isEmpty())
+		return false;
+
+	const uchar* Prefix = (const uchar*)Data.constData();
+
+	const quint32 ID		= qFromLittleEndian<quint32>(Prefix);
+	const int Index			= (int)qFromLittleEndian<quint32>(Prefix + 4);
+	const quint16 Checksum	= qFromLittleEndian<quint16>(Prefix + 8);
+
+	// Chunks behind a corrupt one were already under way when the retransmission was requested
+	if (ID != this->Info.ID || Index != this->NoChunks)
+		return false;
+
+	const char* Payload	= Data.constData() + ChunkPrefixSize;
+	const int Size		= Data.size() - ChunkPrefixSize;
+	const qint64 NoBytes	= this->Info.GetChunkSize(Index);
+
+	char* Voxels = this->Voxels.data() + (qint64)Index * this->Info.ChunkSize;
+
+	// Compressed chunks are decoded straight into the voxel buffer
+	bool Intact = qChecksum(Payload, Size) == Checksum;
+
+	if (Intact)
+	{
+		if (this->Info.Compressed)
+			Intact = QVoxelCodec::Decode((const unsigned char*)Payload, Size, (short*)Voxels, (int)(NoBytes / 2));
+		else
+			Intact = Size == NoBytes;
+	}
+
+	if (!Intact)
+	{
+		qDebug() << "Chunk" << Index << "of" << this->Info.FileName << "is corrupt, requesting it again";
+
+		this->Acknowledge(true);
+		return false;
+	}
+
+	if (!this->Info.Compressed)
+		memcpy(Voxels, Payload, Size);
+
+	this->NoChunks++;
+
+	this->Acknowledge(false);
+
+	if (!this->IsComplete())
+		return false;
+
+	// The volume is written to disk in the background, sharing the voxel buffer
+	if (this->ResourceCache && !this->Info.Hash.isEmpty())
+		this->ResourceCache->Store(this->Info.Hash, this->Voxels, true);
+
+	return true;
+}
+
+bool QVolumeReceiver::IsComplete() const
+{
+	return !this->Voxels.isEmpty() && this->NoChunks == this->Info.GetNoChunks();
+}
+
+void QVolumeReceiver::Release()
+{
+	this->Info		= QVolumeInfo();
+	this->Voxels	= QByteArray();
+	this->NoChunks	= 0;
+}
+
+void QVolumeReceiver::Acknowledge(const bool& Retransmit)
+{
+	QByteArray Data;
+
+	QDataStream DataStream(&Data, QIODevice::WriteOnly);
+	DataStream.setVersion(QDataStream::Qt_4_0);
+
+	DataStream << this->Info.ID;
+	DataStream << this->NoChunks;
+	DataStream << Retransmit;
+
+	this->Socket->SendData(Protocol::VolumeAck, Data);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "basesocket.h"
+#include "resourcecache.h"
+#include "vector\vector.h"
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QIODevice>
+
+using namespace ExposureRender;
+
+/*! Description of a volume that is transferred in chunks
+	The volume is identified by the hash of its voxels, a receiver that has it cached needs no chunks at all and an interrupted transfer can be resumed
+	Compressed chunks carry the voxels of the chunk encoded with the voxel codec, the chunk size always refers to the decoded voxels
+*/
+struct QVolumeInfo
+{
+	QVolumeInfo();
+
+	int GetNoChunks() const;
+	qint64 GetChunkSize(const int& Index) const;
+
+	quint32		ID;
+	QByteArray	Hash;
+	QString		FileName;
+	Vec3i		Resolution;
+	Vec3f		Spacing;
+	qint64		NoBytes;
+	int			ChunkSize;
+	bool		Compressed;
+};
+
+/*! Streams a volume from a file or buffer in checksummed chunks
+	Only a window of chunks is queued at a time, the receiver acknowledges them, asks for corrupt chunks again and tells where to resume after a reconnect
+*/
+class QVolumeSender : public QObject
+{
+    Q_OBJECT
+
+public:
+	QVolumeSender(QBaseSocket* Socket, const int& NoChunksInFlight = 4, QObject* Parent = 0);
+	virtual ~QVolumeSender() {};
+
+	void Start(const QVolumeInfo& Info, QIODevice* Source);
+	void Start(const QVolumeInfo& Info, const QByteArray& Voxels);
+	void Resume();
+	void Stop();
+	void SetNoAvailableChunks(const int& NoAvailableChunks);
+	void OnAcknowledge(QByteArray& Data);
+	bool IsBusy() const;
+
+signals:
+	void Finished();
+
+private:
+	void SendChunks();
+
+private:
+	QBaseSocket*	Socket;
+	QVolumeInfo		Info;
+	QIODevice*		Source;
+	int				NoChunksInFlight;
+	int				NoAvailableChunks;
+	int				NextChunk;
+	int				NoAcknowledgedChunks;
+	bool			Acknowledged;
+	bool			Compress;
+	qint64			NoEncodedBytes;
+	qint64			NoDecodedBytes;
+};
+
+/*! Writes the chunks of a volume straight into its voxel buffer as they arrive
+	A transfer that is interrupted before it completes is kept, the next receiver that is offered the same volume resumes it
+*/
+class QVolumeReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+	QVolumeReceiver(QBaseSocket* Socket, QResourceCache* ResourceCache = 0, QObject* Parent = 0);
+	virtual ~QVolumeReceiver();
+
+	void SetSocket(QBaseSocket* Socket) { this->Socket = Socket; }
+	bool OnHeader(QByteArray& Data);
+	bool OnChunk(QByteArray& Data);
+	bool IsComplete() const;
+	int GetNoChunks() const { return this->NoChunks; }
+	const QVolumeInfo& GetInfo() const { return this->Info; }
+	const QByteArray& GetVoxels() const { return this->Voxels; }
+	void Release();
+
+private:
+	void Acknowledge(const bool& Retransmit);
+
+private:
+	QBaseSocket*	Socket;
+	QResourceCache*	ResourceCache;
+	QVolumeInfo		Info;
+	QByteArray		Voxels;
+	int				NoChunks;
+};